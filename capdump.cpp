@@ -0,0 +1,130 @@
+#include <capture-reader.hpp>
+
+#include <ndn-cxx/interest.hpp>
+#include <ndn-cxx/data.hpp>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+
+void
+usage(std::ostream& os,
+      const boost::program_options::options_description& desc,
+      const char* programName)
+{
+  os << "Usage:\n"
+     << "  " << programName << " [--summary] [--from=<us>] [--to=<us>] packet.out [packet.out.1 ...]\n"
+     << "\n";
+  os << desc;
+}
+
+struct Counter
+{
+  uint64_t nPackets = 0;
+  uint64_t nBytes = 0;
+};
+
+static void
+printPacket(const ndn::iot::capture::Reader& reader, const ndn::iot::capture::Record& record)
+{
+  std::cout << record.timestamp / 1000000 << "."
+	    << std::setw(6) << std::setfill('0') << record.timestamp % 1000000
+	    << (record.direction == ndn::iot::capture::INCOMING ? "  IN " : " OUT ")
+	    << reader.getEntity(record.tag) << " ";
+
+  try {
+    ndn::Block block(record.wire, record.size);
+    if (block.type() == ndn::tlv::Interest) {
+      std::cout << "I " << ndn::Interest(block).getName();
+    }
+    else if (block.type() == ndn::tlv::Data) {
+      std::cout << "D " << ndn::Data(block).getName();
+    }
+    else {
+      std::cout << "? type " << block.type();
+    }
+  }
+  catch (const ndn::tlv::Error& e) {
+    std::cout << "malformed: " << e.what();
+  }
+  std::cout << "\n";
+}
+
+int main(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+  po::options_description optionDesciption;
+
+  uint64_t from = 0;
+  uint64_t to = std::numeric_limits<uint64_t>::max();
+  std::vector<std::string> files;
+  optionDesciption.add_options()
+      ("help,h", "produce help message")
+      ("summary,s", "only count packets and bytes per entity and direction, without decoding")
+      ("from,f", po::value<uint64_t>(&from), "skip packets captured before this time (us since epoch)")
+      ("to,t", po::value<uint64_t>(&to), "stop at packets captured after this time (us since epoch)")
+      ("file", po::value<std::vector<std::string>>(&files), "capture segments to read")
+      ;
+
+  po::positional_options_description positional;
+  positional.add("file", -1);
+
+  po::variables_map options;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(optionDesciption)
+	      .positional(positional).run(), options);
+    po::notify(options);
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+
+  if (options.count("help") || files.empty()) {
+    usage(std::cout, optionDesciption, argv[0]);
+    return 0;
+  }
+
+  bool isSummary = options.count("summary") > 0;
+  std::map<std::string, Counter> counters;
+  for (const auto& file : files) {
+    try {
+      ndn::iot::capture::Reader reader(file);
+      if (from > 0) {
+	reader.seek(from);
+      }
+
+      ndn::iot::capture::Record record;
+      while (reader.next(record) && record.timestamp <= to) {
+	if (!isSummary) {
+	  printPacket(reader, record);
+	  continue;
+	}
+
+	bool isInterest = record.size > 0 && record.wire[0] == ndn::tlv::Interest;
+	auto key = reader.getEntity(record.tag) +
+	  (record.direction == ndn::iot::capture::INCOMING ? "  IN " : " OUT ") +
+	  (isInterest ? "Interest" : "Data");
+	++counters[key].nPackets;
+	counters[key].nBytes += record.size;
+      }
+    }
+    catch (const ndn::iot::capture::Reader::Error& e) {
+      std::cerr << "ERROR: " << e.what() << std::endl;
+      return 2;
+    }
+  }
+
+  for (const auto& counter : counters) {
+    std::cout << counter.first << ": " << counter.second.nPackets << " packets, "
+	      << counter.second.nBytes << " bytes\n";
+  }
+
+  return 0;
+}
@@ -12,7 +12,13 @@ usage(std::ostream& os,
   os << "Usage:\n"
      << "  " << programName << " --name=<device name>\n"
      << "       " << " --secret=<secret to secure the bootstrap process>\n"
-     << "       " << " --enable-discovery"
+     << "       " << " --enable-discovery\n"
+     << "       " << " [--lag-threshold=<ms>] [--callback-threshold=<ms>]"
+     << " [--loop-report=<none|periodic|exit>]\n"
+     << "       " << " [--command-loss=<fraction>]\n"
+     << "       " << " [--keychain=<default|memory|write-behind>] [--exit-when-ready]\n"
+     << "       " << " [--capture=<path>] [--trace=<path>] [--discovery=<adaptive|fixed>]"
+     << " [--discovery-interval=<ms>]\n"
      << "\n";
   os << desc;
 }
@@ -24,6 +30,15 @@ int main(int argc, char** argv)
 
   std::string pinCode;
   std::string devName;
+  int lagThreshold = 50;
+  int callbackThreshold = 20;
+  std::string loopReport = "exit";
+  double commandLoss = 0.0;
+  std::string keyChain = "default";
+  std::string capture;
+  std::string trace;
+  std::string discovery = "adaptive";
+  int discoveryInterval = 1000;
   optionDesciption.add_options()
       ("help,h", "produce help message")
       ("name,i", po::value<std::string>(&devName),
@@ -31,6 +46,25 @@ int main(int argc, char** argv)
       ("secret,s", po::value<std::string>(&pinCode),
        "the secret shared to the AS to secure the bootstrap process")
       ("enable-discovery,d", "enable the device to discovery others")
+      ("lag-threshold", po::value<int>(&lagThreshold),
+       "report a stall when the event loop runs a due event this late (ms)")
+      ("callback-threshold", po::value<int>(&callbackThreshold),
+       "report a stall when a callback runs longer than this (ms)")
+      ("loop-report", po::value<std::string>(&loopReport),
+       "when to report event loop statistics: none, periodic or exit")
+      ("command-loss", po::value<double>(&commandLoss),
+       "drop this fraction of outgoing command Interests, to test retransmission")
+      ("keychain", po::value<std::string>(&keyChain),
+       "where keys and certificates live: default, memory or write-behind")
+      ("exit-when-ready", "print the time from start to ready to answer probes, then exit")
+      ("capture", po::value<std::string>(&capture),
+       "capture the packets of the device into segments of this path, e.g. packet.out")
+      ("trace", po::value<std::string>(&trace),
+       "write onboarding spans to this path with the process ID added, e.g. trace.json")
+      ("discovery", po::value<std::string>(&discovery),
+       "when to run discovery rounds: adaptive (jitter, backoff, suppression) or fixed")
+      ("discovery-interval", po::value<int>(&discoveryInterval),
+       "the fixed interval, or the first one of adaptive rounds (ms)")
       ("version,V", "show version and exit")
       ;
 
@@ -55,7 +89,31 @@ int main(int argc, char** argv)
     return 0;
   }
 
-  ndn::iot::DeviceController controller(pinCode, devName);
+  ndn::iot::EntityOptions entityOptions;
+  entityOptions.loopMonitor.lagThreshold = ndn::time::milliseconds(lagThreshold);
+  entityOptions.loopMonitor.callbackThreshold = ndn::time::milliseconds(callbackThreshold);
+  entityOptions.commandLoss = commandLoss;
+  entityOptions.exitWhenReady = options.count("exit-when-ready") > 0;
+  entityOptions.capturePath = capture;
+  entityOptions.tracePath = trace;
+  entityOptions.discovery.minInterval = ndn::time::milliseconds(discoveryInterval);
+  if (discovery == "fixed") {
+    entityOptions.discovery.mode = ndn::iot::DiscoveryOptions::DISCOVERY_FIXED;
+  }
+  if (keyChain == "memory") {
+    entityOptions.keyChainMode = ndn::iot::EntityOptions::KEYCHAIN_MEMORY;
+  }
+  else if (keyChain == "write-behind") {
+    entityOptions.keyChainMode = ndn::iot::EntityOptions::KEYCHAIN_WRITE_BEHIND;
+  }
+  if (loopReport == "none") {
+    entityOptions.loopMonitor.reportMode = ndn::iot::LoopMonitorOptions::REPORT_NONE;
+  }
+  else if (loopReport == "periodic") {
+    entityOptions.loopMonitor.reportMode = ndn::iot::LoopMonitorOptions::REPORT_PERIODIC;
+  }
+
+  ndn::iot::DeviceController controller(pinCode, devName, entityOptions);
   controller.run();
   
   return 0;
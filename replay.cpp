@@ -0,0 +1,555 @@
+#include <authentication-server.hpp>
+#include <device-controller.hpp>
+#include <capture-reader.hpp>
+#include <discovery-policy.hpp>
+#include <histogram.hpp>
+
+#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/util/dummy-client-face.hpp>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <new>
+#include <thread>
+
+namespace ndn {
+namespace iot {
+
+/** @brief heap allocations of this process, counted by the operator new below
+ */
+static std::atomic<uint64_t> g_nAllocations(0);
+
+struct ReplayPacket
+{
+  uint64_t timestamp;
+  Interest interest;
+};
+
+/** @brief Load the incoming Interests of one entity (or of all) from capture segments
+ */
+static std::vector<ReplayPacket>
+loadInterests(const std::vector<std::string>& files, const std::string& entity)
+{
+  std::vector<ReplayPacket> packets;
+  for (const auto& file : files) {
+    capture::Reader reader(file);
+    capture::Record record;
+    while (reader.next(record)) {
+      if (record.direction != capture::INCOMING || record.size == 0 ||
+	  record.wire[0] != tlv::Interest ||
+	  (!entity.empty() && reader.getEntity(record.tag) != entity)) {
+	continue;
+      }
+
+      try {
+	packets.push_back({record.timestamp, Interest(Block(record.wire, record.size))});
+      }
+      catch (const tlv::Error& e) {
+	std::cerr << "skip malformed Interest: " << e.what() << std::endl;
+      }
+    }
+  }
+  return packets;
+}
+
+/** @brief Feed captured Interests into an entity through an in-process face
+ */
+class Replayer
+{
+public:
+  Replayer(boost::asio::io_service& ioService, util::DummyClientFace& face)
+    : m_ioService(ioService)
+    , m_face(face)
+    , m_nRetransmissions(0)
+    , m_nTimedOut(0)
+    , m_nAllocations(0)
+    , m_nReplies(0)
+  {
+    m_face.onSendData.connect([this] (const Data& data) {
+	auto now = time::steady_clock::now();
+	for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+	  if (it->first.isPrefixOf(data.getName())) {
+	    m_replyLatency.record(time::duration_cast<time::microseconds>(now - it->second).count());
+	    ++m_nReplies;
+	    m_lastReply = now;
+	    m_pending.erase(it);
+	    break;
+	  }
+	}
+      });
+  }
+
+  void
+  replayAsFastAsPossible(const std::vector<ReplayPacket>& packets)
+  {
+    auto start = time::steady_clock::now();
+    auto nAllocations = g_nAllocations.load();
+    for (const auto& packet : packets) {
+      auto before = time::steady_clock::now();
+      m_pending.emplace_back(packet.interest.getName(), before);
+      auto allocationsBefore = g_nAllocations.load();
+      m_face.receive(packet.interest);
+      m_ioService.poll();
+      m_ioService.reset();
+      m_handlerAllocations.record(g_nAllocations - allocationsBefore);
+      m_handlerTime.record(time::duration_cast<time::microseconds>(time::steady_clock::now() -
+								   before).count());
+    }
+    auto fed = time::steady_clock::now();
+    waitForReplies();
+    m_nAllocations = g_nAllocations - nAllocations;
+    // the idle wait for lost replies does not count
+    m_elapsed = std::max(fed, m_lastReply) - start;
+  }
+
+  void
+  replayAtOriginalTiming(const std::vector<ReplayPacket>& packets, Scheduler& scheduler)
+  {
+    if (packets.empty()) {
+      return;
+    }
+
+    auto start = time::steady_clock::now();
+    auto nAllocations = g_nAllocations.load();
+    uint64_t first = packets.front().timestamp;
+    for (const auto& packet : packets) {
+      auto offset = time::microseconds(packet.timestamp - first);
+      scheduler.scheduleEvent(offset, [this, &packet] {
+	  auto before = time::steady_clock::now();
+	  m_pending.emplace_back(packet.interest.getName(), before);
+	  m_face.receive(packet.interest);
+	  m_handlerTime.record(time::duration_cast<time::microseconds>(
+				 time::steady_clock::now() - before).count());
+	});
+    }
+
+    auto last = time::microseconds(packets.back().timestamp - first);
+    scheduler.scheduleEvent(last + time::seconds(1), [this] { m_ioService.stop(); });
+    m_ioService.run();
+    m_ioService.reset();
+    m_elapsed = time::steady_clock::now() - start;
+    m_nAllocations = g_nAllocations - nAllocations;
+  }
+
+  /** @brief let the replies of work offloaded to worker threads come back
+   */
+  void
+  waitForReplies()
+  {
+    const auto IDLE_TIMEOUT = time::seconds(1);
+    auto lastProgress = time::steady_clock::now();
+    while (!m_pending.empty() && time::steady_clock::now() - lastProgress < IDLE_TIMEOUT) {
+      size_t nReplies = m_nReplies;
+      m_ioService.poll();
+      m_ioService.reset();
+      if (m_nReplies > nReplies) {
+	lastProgress = time::steady_clock::now();
+      }
+      else {
+	std::this_thread::yield();
+      }
+    }
+  }
+
+  void
+  report(std::ostream& os, size_t nPackets) const
+  {
+    auto seconds = time::duration_cast<time::microseconds>(m_elapsed).count() / 1e6;
+    os << "replayed " << nPackets << " Interests in " << seconds << " s ("
+       << (seconds > 0 ? nPackets / seconds : 0) << " Interests/s)\n"
+       << "handler time (us): " << m_handlerTime << "\n"
+       << "reply latency (us): " << m_replyLatency << "\n"
+       << "unanswered: " << nPackets - m_nReplies << "\n"
+       << "allocations per Interest: " << (nPackets > 0 ? m_nAllocations / nPackets : 0)
+       << " (including the replayer and idle timers)\n";
+    if (m_handlerAllocations.getCount() > 0) {
+      os << "allocations to receive and handle an Interest: " << m_handlerAllocations << "\n";
+    }
+  }
+
+  /** @brief Issue commands from @p entity one after another to a responder behind the face
+   *
+   *  The responder answers every command Interest that reaches the face after @p rtt, so
+   *  only the loss injected by EntityOptions::commandLoss costs retransmissions.
+   */
+  void
+  issueCommands(Entity& entity, size_t nCommands, time::milliseconds rtt, Scheduler& scheduler)
+  {
+    const Name RESPONDER_PREFIX("/replay/responder");
+    KeyChain keyChain("pib-memory:", "tpm-memory:");
+    util::signal::ScopedConnection responder = m_face.onSendInterest.connect(
+      [&] (const Interest& interest) {
+	if (!RESPONDER_PREFIX.isPrefixOf(interest.getName())) {
+	  return;
+	}
+	auto name = interest.getName();
+	scheduler.scheduleEvent(rtt, [this, &keyChain, name] {
+	    Data data(name);
+	    data.setFreshnessPeriod(time::seconds(1));
+	    keyChain.sign(data, security::signingWithSha256());
+	    m_face.receive(data);
+	  });
+      });
+
+    auto counters = Metrics::snapshot().counters;
+    auto signer = [] (Interest& interest, KeyChain& keyChain) {
+      keyChain.sign(interest, security::signingWithSha256());
+    };
+    auto start = time::steady_clock::now();
+    size_t nIssued = 0;
+    std::function<void()> issueNext = [&] {
+      if (nIssued == nCommands) {
+	return m_ioService.stop();
+      }
+      auto command = entity.makeCommand(Name(RESPONDER_PREFIX).appendNumber(nIssued++),
+					ControlParameters(), signer);
+      auto issuedAt = time::steady_clock::now();
+      entity.issueCommand(command,
+			  [&, issuedAt] (const Block&) {
+			    m_commandTime.record(time::duration_cast<time::microseconds>(
+						   time::steady_clock::now() - issuedAt).count());
+			    ++m_nReplies;
+			    m_ioService.post(issueNext);
+			  },
+			  bind([] { return true; }),
+			  [&] (const std::string& reason) {
+			    ++m_commandFailures[reason];
+			    m_ioService.post(issueNext);
+			  });
+    };
+    m_ioService.post(issueNext);
+    m_ioService.run();
+    m_ioService.reset();
+    scheduler.cancelAllEvents();
+
+    m_elapsed = time::steady_clock::now() - start;
+    auto after = Metrics::snapshot().counters;
+    m_nRetransmissions = after[Metrics::COMMAND_RETRANSMITTED] -
+			 counters[Metrics::COMMAND_RETRANSMITTED];
+    m_nTimedOut = after[Metrics::COMMAND_TIMED_OUT] - counters[Metrics::COMMAND_TIMED_OUT];
+  }
+
+  void
+  reportCommands(std::ostream& os, size_t nCommands, double loss) const
+  {
+    auto seconds = time::duration_cast<time::microseconds>(m_elapsed).count() / 1e6;
+    os << "issued " << nCommands << " commands at " << loss * 100 << "% loss in "
+       << seconds << " s: " << m_nReplies << " answered\n"
+       << "retransmissions: " << m_nRetransmissions << " ("
+       << (nCommands > 0 ? static_cast<double>(m_nRetransmissions) / nCommands : 0)
+       << " per command), timed out: " << m_nTimedOut << "\n"
+       << "completion time of answered commands (us): " << m_commandTime << "\n";
+    for (const auto& failure : m_commandFailures) {
+      os << "failed with " << failure.first << ": " << failure.second << "\n";
+    }
+  }
+
+private:
+  boost::asio::io_service& m_ioService;
+  util::DummyClientFace& m_face;
+
+  std::list<std::pair<Name, time::steady_clock::TimePoint>> m_pending;
+  Histogram m_handlerTime;
+  Histogram m_replyLatency;
+  Histogram m_handlerAllocations;
+  Histogram m_commandTime;
+  std::map<std::string, size_t> m_commandFailures;
+  uint64_t m_nRetransmissions;
+  uint64_t m_nTimedOut;
+  uint64_t m_nAllocations;
+  size_t m_nReplies;
+  time::steady_clock::TimePoint m_lastReply;
+  time::nanoseconds m_elapsed;
+};
+
+/** @brief Discovery rounds of devices on one link that all power up at once, in virtual time
+ *
+ *  Every device runs its own DiscoveryPolicy.  A round that is not suppressed is a probe
+ *  that every other device overhears, and that makes the prober and the others neighbors
+ *  of each other once its replies are collected.  This measures the policy, not the
+ *  forwarder: the link delivers every probe, and Interest loss and collisions are ignored.
+ */
+static void
+simulateDiscovery(size_t nDevices, const DiscoveryOptions& options, time::seconds duration,
+		  std::ostream& os)
+{
+  // one collect round, until a round stays silent for the default window
+  const int64_t COLLECT_TIME = 500; // ms
+  const int64_t end = time::duration_cast<time::milliseconds>(duration).count();
+  const time::steady_clock::TimePoint origin;
+
+  enum EventType {
+    ROUND_DUE,
+    ROUND_COLLECTED
+  };
+
+  struct Device
+  {
+    DiscoveryPolicy policy;
+    int64_t scheduledAt;
+    int64_t lastOverheardProbe;
+    std::vector<bool> neighbors;
+    bool hasNewNeighbor;
+  };
+
+  std::vector<Device> devices;
+  std::multimap<int64_t, std::pair<EventType, size_t>> events;
+  for (size_t i = 0; i < nDevices; ++i) {
+    devices.push_back({DiscoveryPolicy(options), 0, -1, std::vector<bool>(nDevices, false),
+		       false});
+    devices[i].neighbors[i] = true;
+    events.emplace(devices[i].policy.getDelay().count(), std::make_pair(ROUND_DUE, i));
+  }
+
+  size_t nProbes = 0;
+  size_t nSuppressed = 0;
+  size_t nPairs = 0;
+  int64_t allKnownAt = -1;
+  std::map<int64_t, size_t> probesPerSecond;
+  auto meet = [&] (size_t i, size_t j) {
+    if (devices[i].neighbors[j]) {
+      return false;
+    }
+    devices[i].neighbors[j] = true;
+    ++nPairs;
+    return true;
+  };
+
+  while (!events.empty() && events.begin()->first < end) {
+    auto now = events.begin()->first;
+    auto type = events.begin()->second.first;
+    auto index = events.begin()->second.second;
+    auto& device = devices[index];
+    events.erase(events.begin());
+
+    if (type == ROUND_COLLECTED) {
+      device.policy.afterRound(device.hasNewNeighbor);
+      device.scheduledAt = now;
+      events.emplace(now + device.policy.getDelay().count(), std::make_pair(ROUND_DUE, index));
+      continue;
+    }
+
+    if (device.policy.isSuppressed(origin + time::milliseconds(device.scheduledAt),
+				   origin + time::milliseconds(device.lastOverheardProbe))) {
+      ++nSuppressed;
+      device.policy.afterRound(false);
+      device.scheduledAt = now;
+      events.emplace(now + device.policy.getDelay().count(), std::make_pair(ROUND_DUE, index));
+      continue;
+    }
+
+    ++nProbes;
+    ++probesPerSecond[now / 1000];
+    device.hasNewNeighbor = false;
+    for (size_t j = 0; j < nDevices; ++j) {
+      if (j == index) {
+	continue;
+      }
+      devices[j].lastOverheardProbe = now;
+      meet(j, index);
+      device.hasNewNeighbor |= meet(index, j);
+    }
+    if (allKnownAt < 0 && nPairs == nDevices * (nDevices - 1)) {
+      allKnownAt = now;
+    }
+    events.emplace(now + COLLECT_TIME, std::make_pair(ROUND_COLLECTED, index));
+  }
+
+  size_t peak = 0;
+  for (const auto& second : probesPerSecond) {
+    peak = std::max(peak, second.second);
+  }
+  auto seconds = end / 1000.0;
+  os << (options.mode == DiscoveryOptions::DISCOVERY_FIXED ? "fixed" : "adaptive")
+     << " discovery of " << nDevices << " devices over " << seconds << " s: "
+     << nProbes << " probes (" << nProbes / seconds << "/s), "
+     << nSuppressed << " suppressed, peak " << peak << " probes in one second, "
+     << "first second " << (probesPerSecond.count(0) > 0 ? probesPerSecond[0] : 0) << ", "
+     << "all neighbors known ";
+  if (allKnownAt >= 0) {
+    os << "after " << allKnownAt / 1000.0 << " s\n";
+  }
+  else {
+    os << "never\n";
+  }
+}
+
+} // namespace iot
+} // namespace ndn
+
+void*
+operator new(std::size_t size)
+{
+  ++ndn::iot::g_nAllocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+usage(std::ostream& os,
+      const boost::program_options::options_description& desc,
+      const char* programName)
+{
+  os << "Usage:\n"
+     << "  " << programName << " --target=<as|device> [--name=<entity name>] [--secret=<pin>]\n"
+     << "       " << " [--entity=<captured entity>] [--original-timing] [--threads=<n>]\n"
+     << "       " << " packet.out [...]\n"
+     << "  " << programName << " --target=<as|device> --issue-commands=<n>\n"
+     << "       " << " [--command-loss=<fraction>] [--rtt=<ms>]\n"
+     << "  " << programName << " --simulate-discovery=<devices> [--discovery=<adaptive|fixed>]\n"
+     << "       " << " [--discovery-interval=<ms>] [--duration=<s>]\n"
+     << "\n";
+  os << desc;
+}
+
+int main(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+  po::options_description optionDesciption;
+
+  std::string target = "as";
+  std::string name;
+  std::string pinCode;
+  std::string entity;
+  size_t nThreads = 0;
+  size_t nSimulatedDevices = 0;
+  std::string discovery = "adaptive";
+  int discoveryInterval = 1000;
+  int duration = 600;
+  size_t nCommands = 0;
+  double commandLoss = 0.0;
+  int rtt = 20;
+  std::vector<std::string> files;
+  optionDesciption.add_options()
+      ("help,h", "produce help message")
+      ("target,t", po::value<std::string>(&target), "the entity to drive: as or device")
+      ("name,i", po::value<std::string>(&name), "the name of the entity, defaults to the captured one")
+      ("secret,s", po::value<std::string>(&pinCode), "the bootstrap secret of the device")
+      ("entity,e", po::value<std::string>(&entity), "only replay Interests captured by this entity")
+      ("original-timing,o", "replay at the captured pace instead of as fast as possible")
+      ("threads,j", po::value<size_t>(&nThreads), "worker threads of the entity, none by default")
+      ("simulate-discovery", po::value<size_t>(&nSimulatedDevices),
+       "run the discovery rounds of this many devices on one link in virtual time")
+      ("discovery", po::value<std::string>(&discovery),
+       "the discovery policy to simulate: adaptive or fixed")
+      ("discovery-interval", po::value<int>(&discoveryInterval),
+       "the fixed interval, or the first one of adaptive rounds (ms)")
+      ("duration", po::value<int>(&duration), "the simulated time (s)")
+      ("issue-commands", po::value<size_t>(&nCommands),
+       "issue this many commands from the entity instead of replaying Interests")
+      ("command-loss", po::value<double>(&commandLoss),
+       "the fraction of command Interests dropped instead of sent")
+      ("rtt", po::value<int>(&rtt), "the delay of the responder to issued commands (ms)")
+      ("file", po::value<std::vector<std::string>>(&files), "capture segments to replay")
+      ;
+
+  po::positional_options_description positional;
+  positional.add("file", -1);
+
+  po::variables_map options;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(optionDesciption)
+	      .positional(positional).run(), options);
+    po::notify(options);
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+
+  if (nSimulatedDevices > 0) {
+    ndn::iot::DiscoveryOptions discoveryOptions;
+    discoveryOptions.minInterval = ndn::time::milliseconds(discoveryInterval);
+    if (discovery == "fixed") {
+      discoveryOptions.mode = ndn::iot::DiscoveryOptions::DISCOVERY_FIXED;
+    }
+    ndn::iot::simulateDiscovery(nSimulatedDevices, discoveryOptions,
+				ndn::time::seconds(duration), std::cout);
+    return 0;
+  }
+
+  if (options.count("help") || (files.empty() && nCommands == 0)) {
+    usage(std::cout, optionDesciption, argv[0]);
+    return 0;
+  }
+
+  std::vector<ndn::iot::ReplayPacket> packets;
+  try {
+    packets = ndn::iot::loadInterests(files, entity);
+  }
+  catch (const ndn::iot::capture::Reader::Error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 2;
+  }
+  if (name.empty()) {
+    name = entity.empty() ? "/iot/shannon/as" : entity;
+  }
+
+  ndn::util::DummyClientFace* face = nullptr;
+  ndn::iot::EntityOptions entityOptions;
+  entityOptions.capturePath = "";
+  entityOptions.tracePath = "";
+  entityOptions.nWorkerThreads = nThreads;
+  entityOptions.commandLoss = commandLoss;
+  entityOptions.keyChainMode = ndn::iot::EntityOptions::KEYCHAIN_MEMORY;
+  entityOptions.makeFace = [&face] (boost::asio::io_service& ioService, ndn::KeyChain& keyChain) {
+    auto dummy = ndn::make_unique<ndn::util::DummyClientFace>(
+      ioService, keyChain, ndn::util::DummyClientFace::Options{false, true});
+    face = dummy.get();
+    return ndn::unique_ptr<ndn::Face>(std::move(dummy));
+  };
+
+  ndn::unique_ptr<ndn::iot::Entity> instance;
+  if (target == "as") {
+    auto as = ndn::make_unique<ndn::iot::AuthenticationServer>(name, entityOptions);
+    instance = std::move(as);
+  }
+  else if (target == "device") {
+    auto device = ndn::make_unique<ndn::iot::DeviceController>(pinCode, name, entityOptions);
+    instance = std::move(device);
+  }
+  else {
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+  auto& ioService = instance->getIoService();
+
+  // let the entity finish its local registrations before the first Interest
+  ioService.poll();
+  ioService.reset();
+
+  ndn::iot::Replayer replayer(ioService, *face);
+  if (nCommands > 0) {
+    ndn::Scheduler scheduler(ioService);
+    replayer.issueCommands(*instance, nCommands, ndn::time::milliseconds(rtt), scheduler);
+    replayer.reportCommands(std::cout, nCommands, commandLoss);
+    return 0;
+  }
+  if (options.count("original-timing")) {
+    ndn::Scheduler scheduler(ioService);
+    replayer.replayAtOriginalTiming(packets, scheduler);
+  }
+  else {
+    replayer.replayAsFastAsPossible(packets);
+  }
+  replayer.report(std::cout, packets.size());
+
+  return 0;
+}
@@ -1,19 +1,189 @@
 #include <authentication-server.hpp>
 
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include <csignal>
+#include <sys/prctl.h>
+#include <unistd.h>
+
 namespace ndn {
 namespace iot {
 
+/** @brief Start the workers of a front as child processes of this program
+ */
+static std::vector<pid_t>
+spawnWorkers(const std::string& name, const EntityOptions& options, size_t nWorkers,
+	     const std::string& keyChain, const std::string& idleTimeout,
+	     const std::string& capture, const std::string& trace)
+{
+  // create the shared identity before the workers race to, in the keychain they will use;
+  // the write-behind PIB is written through once the KeyChain is gone
+  makeKeyChain(options)->createIdentity(name);
+
+  auto count = std::to_string(nWorkers);
+  std::vector<pid_t> workers;
+  for (size_t i = 0; i < nWorkers; ++i) {
+    // nothing but async-signal-safe calls in the child before exec
+    auto worker = std::to_string(i);
+    std::vector<const char*> argv = {"server.app", "--name", name.data(),
+				     "--worker", worker.data(), "--workers", count.data(),
+				     "--keychain", keyChain.data(),
+				     "--idle-timeout", idleTimeout.data()};
+    if (!capture.empty()) {
+      argv.insert(argv.end(), {"--capture", capture.data()});
+    }
+    if (!trace.empty()) {
+      argv.insert(argv.end(), {"--trace", trace.data()});
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = ::fork();
+    if (pid < 0) {
+      std::cerr << "ERROR: cannot start worker " << i << std::endl;
+      continue;
+    }
+    if (pid > 0) {
+      workers.push_back(pid);
+      continue;
+    }
+
+    ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+    ::execv("/proc/self/exe", const_cast<char**>(argv.data()));
+    ::_exit(127);
+  }
+  return workers;
+}
+
 int
-main()
+main(const std::string& name, const ShardOptions& shardOptions, const std::string& keyChain,
+     size_t idleTimeout, const std::string& capture, const std::string& trace,
+     bool exitWhenReady)
 {
-  ndn::iot::AuthenticationServer as("/iot/shannon/as");
+  EntityOptions options;
+  options.capturePath = capture;
+  options.tracePath = trace;
+  options.exitWhenReady = exitWhenReady;
+  options.faceManager.idleTimeout = time::seconds(idleTimeout);
+  if (keyChain == "memory") {
+    options.keyChainMode = EntityOptions::KEYCHAIN_MEMORY;
+  }
+  else if (keyChain == "write-behind") {
+    options.keyChainMode = EntityOptions::KEYCHAIN_WRITE_BEHIND;
+  }
+  if (shardOptions.role == ShardOptions::WORKER) {
+    auto suffix = "-shard" + std::to_string(shardOptions.shardId);
+    auto extension = capture.rfind('.');
+    if (!capture.empty() && extension != std::string::npos) {
+      options.capturePath = capture.substr(0, extension) + suffix + capture.substr(extension);
+    }
+    else if (!capture.empty()) {
+      options.capturePath = capture + suffix;
+    }
+  }
+
+  std::vector<pid_t> workers;
+  if (shardOptions.role == ShardOptions::FRONT) {
+    workers = spawnWorkers(name, options, shardOptions.nShards, keyChain,
+			   std::to_string(idleTimeout), capture, trace);
+  }
+
+  ndn::iot::AuthenticationServer as(name, options, shardOptions);
   as.run();
+
+  for (auto pid : workers) {
+    ::kill(pid, SIGTERM);
+  }
   return 0;
 }
 
 } // namespace iot
 } // namespace ndn
 
+void
+usage(std::ostream& os,
+      const boost::program_options::options_description& desc,
+      const char* programName)
+{
+  os << "Usage:\n"
+     << "  " << programName << " [--name=<AS name>]"
+     << " [--keychain=<default|memory|write-behind>] [--idle-timeout=<seconds>]"
+     << " [--capture=<path>] [--trace=<path>] [--exit-when-ready]\n"
+     << "  " << programName << " [--name=<AS name>] --front --workers=<n>\n"
+     << "\n";
+  os << desc;
+}
+
 int main(int argc, char** argv) {
-  return ndn::iot::main();
+  namespace po = boost::program_options;
+  po::options_description optionDesciption;
+
+  std::string name = "/iot/shannon/as";
+  size_t nWorkers = 0;
+  size_t shardId = 0;
+  std::string keyChain = "default";
+  size_t idleTimeout = 600;
+  std::string capture;
+  std::string trace;
+  optionDesciption.add_options()
+      ("help,h", "produce help message")
+      ("name,i", po::value<std::string>(&name), "the name and identity of the AS")
+      ("front,f", "probe devices and hand them off to worker processes")
+      ("workers,n", po::value<size_t>(&nWorkers), "the number of workers")
+      ("worker,w", po::value<size_t>(&shardId), "run as the worker of this index")
+      ("keychain", po::value<std::string>(&keyChain),
+       "where keys and certificates live: default, memory or write-behind")
+      ("idle-timeout", po::value<size_t>(&idleTimeout),
+       "destroy a face toward a device idle for this many seconds, never if 0")
+      ("capture", po::value<std::string>(&capture),
+       "capture the packets of the AS into segments of this path, e.g. packet.out")
+      ("trace", po::value<std::string>(&trace),
+       "write onboarding spans to this path with the process ID added, e.g. trace.json")
+      ("exit-when-ready", "print the time from start to ready to add devices, then exit")
+      ;
+
+  po::variables_map options;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(optionDesciption).run(), options);
+    po::notify(options);
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+
+  if (options.count("help")) {
+    usage(std::cout, optionDesciption, argv[0]);
+    return 0;
+  }
+
+  ndn::iot::ShardOptions shardOptions;
+  shardOptions.nShards = nWorkers;
+  if (options.count("front")) {
+    shardOptions.role = ndn::iot::ShardOptions::FRONT;
+  }
+  else if (options.count("worker")) {
+    shardOptions.role = ndn::iot::ShardOptions::WORKER;
+    shardOptions.shardId = shardId;
+  }
+
+  if (shardOptions.role != ndn::iot::ShardOptions::STANDALONE &&
+      (nWorkers == 0 || shardId >= nWorkers)) {
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+
+  // workers must share the anchor certificate of the front, which a keychain in memory
+  // cannot hand over to another process
+  if (shardOptions.role != ndn::iot::ShardOptions::STANDALONE && keyChain == "memory") {
+    std::cerr << "ERROR: --keychain=memory cannot be shared by a front and its workers"
+	      << std::endl << std::endl;
+    usage(std::cerr, optionDesciption, argv[0]);
+    return 1;
+  }
+
+  return ndn::iot::main(name, shardOptions, keyChain, idleTimeout, capture, trace,
+			options.count("exit-when-ready") > 0);
 }
@@ -1,23 +1,54 @@
 #include "authentication-server.hpp"
 #include "logger.hpp"
+#include "packet-capture.hpp"
 
 #include <ndn-cxx/security/signing-helpers.hpp>
 
 namespace ndn {
 namespace iot {
 
+NDN_IOT_LOG_INIT(as);
+
 static const Name PROBE_DEVICE_PREFIX("/localhop/probe-device");
 static const time::nanoseconds FACEURI_CANONIZE_TIMEOUT = time::milliseconds(100);
 
-AuthenticationServer::AuthenticationServer(const Name& name)
-  : Entity(name, true)
+AuthenticationServer::AuthenticationServer(const Name& name,
+					   const EntityOptions& options,
+					   const ShardOptions& shardOptions)
+  : Entity(name, true, options)
+  , m_shardOptions(shardOptions)
+  , m_ring(shardOptions.role == ShardOptions::FRONT ? shardOptions.nShards : 0)
 {
   LOG_WELCOME("Authentication Server", m_name);
+
+  if (m_shardOptions.role == ShardOptions::WORKER) {
+    LOG_INFO("worker " << m_shardOptions.shardId << " of " << m_shardOptions.nShards);
+    registerCommandHandler(getShardPrefix(m_shardOptions.shardId), "enroll",
+			   bind(&AuthenticationServer::handleHandOff, this, _1, _2));
+    return;
+  }
   
-  m_agent.registerTopPrefix(PROBE_DEVICE_PREFIX);
+  // every multicast prefix of the AS in one batch, the entity is ready once all are routed
+  auto probing = deferReady();
+  m_agent.registerTopPrefixes({PROBE_DEVICE_PREFIX}, probing, [probing] {
+      LOG_FAILURE("as", "devices cannot probe this AS over multicast, ready without");
+      probing();
+    });
 
   registerCommandHandler("localhost", "add-device",
   			 bind(&AuthenticationServer::addDevice, this, _1, _2));
+
+  if (m_shardOptions.role == ShardOptions::FRONT) {
+    // workers register the longer prefixes of the devices they enrolled
+    auto prefix = Name(m_name).append("apply-cert");
+    listen(prefix, bind(&AuthenticationServer::rejectUnknownApplication, this, _2));
+  }
+}
+
+Name
+AuthenticationServer::getShardPrefix(size_t shardId)
+{
+  return Name("/localhost/as-shard").appendNumber(shardId);
 }
 
 void
@@ -29,137 +60,205 @@ AuthenticationServer::addDevice(const ControlParameters& params,
     return done(ControlResponse(0, "invalid parameters for add dev").wireEncode());
   }
 
+  boost::asio::spawn(m_ioService, bind(&AuthenticationServer::onboardDevice, this,
+				       params, done, _1));
+}
+
+void
+AuthenticationServer::onboardDevice(const ControlParameters& params,
+				    const ReplyWithContent& done,
+				    boost::asio::yield_context yield)
+{
   LOG_STEP(1.1, "Probe the device whose pin code is: " << params.getPinCode());
 
+  // the device echoes the trace ID in its certificate application
+  trace::Span enrollment(trace::generateTraceId(), "enroll");
+  trace::Span probe(enrollment.getTraceId(), "probe");
+
+  const auto& pin = params.getPinCode();
   auto probeParameters = params;
-  probeParameters.setName(m_name).unsetPinCode();
+  probeParameters.setName(m_name).unsetPinCode().setTraceId(enrollment.getTraceId());
 
   auto command = makeCommand(PROBE_DEVICE_PREFIX, probeParameters,
-			     bind(&hmac::signInterest, _1, params.getPinCode()));
-
-  broadcast(command,
-	    bind(&AuthenticationServer::handleProbeResponse,
-		 this, _1, done, params.getPinCode()),
-	    bind(&hmac::verifyData, _1, params.getPinCode()),
-	    [done] (const std::string& reason) {
-	      done(ControlResponse(1, reason).wireEncode());
-	    });
-}
+			     bind(&hmac::signInterest, _1, pin));
+  auto content = broadcast(command, yield, bind(&hmac::verifyData, _1, pin));
+  probe.end();
+  if (!content.isValid()) {
+    return done(ControlResponse(1, "no valid probe response").wireEncode());
+  }
 
-void
-AuthenticationServer::handleProbeResponse(const Block& content,
-					  const ReplyWithContent& done,
-					  const std::string& pin)
-{
   LOG_DBG("Get probe response");
-  
   Name devName;
+  std::vector<std::string> uris;
   try {
+    content.parse();
     devName.wireDecode(content.get(tlv::Name));
-  }
-  catch (const tlv::Error& e) {
-    return done(ControlResponse(2, e.what()).wireEncode());
-  }
 
-  try {
     auto devUris = content.get(tlv::iot::DeviceUris);
     devUris.parse();
-    
-    std::vector<std::string> availableUris;
     for (const auto& ele : devUris.elements()) {
-      availableUris.push_back(readString(ele));
+      uris.push_back(readString(ele));
     }
-
-    auto cbDeviceConnected = bind(&AuthenticationServer::afterConnectToDevice, this,
-				  _1, devName, done);
-
-    LOG_DBG("Try to create face toward the device" << devName);
-    connectToDevice(availableUris, cbDeviceConnected, done);  
   }
   catch (const tlv::Error& e) {
-    return done(ControlResponse(3, e.what()).wireEncode());
+    return done(ControlResponse(devName.empty() ? 2 : 3, e.what()).wireEncode());
   }
 
-  LOG_DBG("Be ready to certificate application from " << devName);
-
-  // ready for cert application
-  registerCommandHandler(Name(m_name).append("apply-cert"), devName,
-			 bind(&AuthenticationServer::issueCertificate, this, _1, _2),
-			 SecurityOptions(pin));
+  auto response = enrollDevice(devName, uris, pin, enrollment.getTraceId(), yield);
+  enrollment.end();
+  done(response);
 }
 
-void
-AuthenticationServer::connectToDevice(std::vector<std::string> pendingUris,
-				      const CommandSucceedCallback& cbDeviceConnected,
-				      const ReplyWithContent& done)
+Block
+AuthenticationServer::enrollDevice(const Name& devName, const std::vector<std::string>& uris,
+				   const std::string& pin, trace::TraceId traceId,
+				   boost::asio::yield_context yield)
 {
-  if (pendingUris.empty()) {
-    LOG_FAILURE("create face", "all provided uris are not accessible");
-    return done(ControlResponse(4, "none device uris can be connected to!").wireEncode());
+  if (m_shardOptions.role == ShardOptions::FRONT) {
+    return handOffDevice(devName, uris, pin, traceId, yield);
   }
 
-  FaceUri uri(pendingUris.back());
-  pendingUris.pop_back();
+  LOG_DBG("Be ready to certificate application from " << devName);
+
+  // ready for cert application; a worker registers a prefix of this device only so
+  // that the applications of devices enrolled by other workers do not reach it
+  auto application = Name("apply-cert").append(devName);
+  auto issue = bind(&AuthenticationServer::issueCertificate, this, _1, _2);
+  if (m_shardOptions.role == ShardOptions::WORKER) {
+    registerCommandHandler(Name(m_name).append(application), Name(), issue, SecurityOptions(pin));
+  }
+  else {
+    registerCommandHandler(m_name, application, issue, SecurityOptions(pin));
+  }
 
-  LOG_DBG("Try " << uri);
-  uri.canonize(bind(&AuthenticationServer::createFaceTowardDevice, this,
-		    _1, pendingUris, cbDeviceConnected, done),
-	       bind(&AuthenticationServer::connectToDevice, this,
-		    pendingUris, cbDeviceConnected, done),
-	       m_ioService, FACEURI_CANONIZE_TIMEOUT);
+  LOG_DBG("Try to create face toward the device" << devName);
+  trace::Span faceCreation(traceId, "face-create");
+  nfd::ControlParameters face;
+  if (!connectToDevice(uris, face, yield)) {
+    return ControlResponse(4, "none device uris can be connected to!").wireEncode();
+  }
+  faceCreation.end();
+
+  LOG_DBG("register device name " << devName << " on created face: "
+	   << face.getUri() << " ( " << face.getFaceId() << " )");
+  m_forwarderState.addFace(face.getFaceId(), face.getUri());
+  m_faceManager.track(face.getUri());
+
+  trace::Span registration(traceId, "rib-register");
+  auto response = registerPrefixOnFace(devName, face.getFaceId(), yield);
+  registration.end();
+  if (response.getCode() != 200) {
+    LOG_FAILURE("register dev name", "Error " << response.getCode()
+		<< "for face " << face.getFaceId() << " (" << face.getUri() << "): "
+		<< response.getText());
+    return response.wireEncode();
+  }
+
+  LOG_DBG("registration succeeds");
+  return ControlResponse(200, "ok").wireEncode();
 }
 
-void
-AuthenticationServer::createFaceTowardDevice(const FaceUri& canonicalUri,
-					     std::vector<std::string> pendingUris,
-					     const CommandSucceedCallback& cbDeviceConnected,
-					     const ReplyWithContent& done)
+Block
+AuthenticationServer::handOffDevice(const Name& devName, const std::vector<std::string>& uris,
+				    const std::string& pin, trace::TraceId traceId,
+				    boost::asio::yield_context yield)
 {
-  m_controller.start<nfd::FaceCreateCommand>(
-    nfd::ControlParameters().setUri(canonicalUri.toString()),
-    cbDeviceConnected,
-    bind(&AuthenticationServer::afterCreateFaceFailed, this,
-	 _1, pendingUris, cbDeviceConnected, done));
+  auto shardId = m_ring.getShard(devName);
+  LOG_DBG("Hand " << devName << " off to worker " << shardId);
+
+  auto params = ControlParameters()
+    .setName(devName)
+    .setPinCode(pin)
+    .setDeviceUris(uris)
+    .setTraceId(traceId);
+
+  trace::Span handOff(traceId, "hand-off");
+  auto content = issueCommand(makeCommand(getShardPrefix(shardId).append("enroll"), params),
+			      yield);
+  if (!content.isValid()) {
+    return ControlResponse(5, "worker " + std::to_string(shardId) + " did not answer")
+      .wireEncode();
+  }
+  // thrown inside the coroutine, this would escape the event loop of the front
+  try {
+    return content.blockFromValue();
+  }
+  catch (const tlv::Error& e) {
+    return ControlResponse(6, "invalid reply of worker " + std::to_string(shardId) + ": " +
+			   e.what()).wireEncode();
+  }
 }
 
 void
-AuthenticationServer::afterCreateFaceFailed(const nfd::ControlResponse& resp,
-					    std::vector<std::string> pendingUris,
-					    const CommandSucceedCallback& cbDeviceConnected,
-					    const ReplyWithContent& done)
+AuthenticationServer::handleHandOff(const ControlParameters& params,
+				    const ReplyWithContent& done)
 {
-  if (resp.getCode() == 409) {
-    LOG_DBG("face already exists");
-    cbDeviceConnected(nfd::ControlParameters(resp.getBody()));
+  if (!params.hasName() || !params.hasPinCode() || !params.hasDeviceUris()) {
+    return done(ControlResponse(0, "invalid parameters for enroll").wireEncode());
   }
-  else {
-    connectToDevice(pendingUris, cbDeviceConnected, done);
-  }  
+
+  LOG_DBG("Enroll " << params.getName() << " handed off by the front");
+  std::vector<std::string> uris;
+  try {
+    uris = params.getDeviceUris();
+  }
+  catch (const tlv::Error& e) {
+    return done(ControlResponse(3, e.what()).wireEncode());
+  }
+
+  auto traceId = params.hasTraceId() ? params.getTraceId() : trace::generateTraceId();
+  boost::asio::spawn(m_ioService, [this, params, uris, traceId, done] (boost::asio::yield_context yield) {
+      done(enrollDevice(params.getName(), uris, params.getPinCode(), traceId, yield));
+    });
 }
 
 void
-AuthenticationServer::afterConnectToDevice(const nfd::ControlParameters& params,
-					   const Name& name,
-					   const ReplyWithContent& done)
+AuthenticationServer::rejectUnknownApplication(const Interest& interest)
 {
-  LOG_DBG("register device name " << name << " on created face: "
-	   << params.getUri() << " ( " << params.getFaceId() << " )");
-  
-  m_createdFaces.push_back(params.getFaceId());
-  
-  registerPrefixOnFace(name, params.getFaceId(),
-		       [done] (const nfd::ControlParameters&) {
-			 LOG_DBG("registration succeeds")
-			 done(ControlResponse(200, "ok").wireEncode());
-		       },
-		       [done, params] (const nfd::ControlResponse& resp) {
-			 LOG_FAILURE("register dev name", "Error "
-				     << resp.getCode()
-				     << "for face " << params.getFaceId()
-				     << " (" << params.getUri()
-				     << "): " << resp.getText());
-			 done(resp.wireEncode());
-		       });
+  capturePacket(interest, capture::INCOMING);
+  LOG_INTEREST_IN(interest);
+  LOG_FAILURE("shard", "no worker enrolled the applicant of " << interest.getName());
+
+  lp::Nack nack(interest);
+  nack.setReason(lp::NackReason::NO_ROUTE);
+  m_face.put(nack);
+}
+
+bool
+AuthenticationServer::connectToDevice(const std::vector<std::string>& uris,
+				      nfd::ControlParameters& face,
+				      boost::asio::yield_context yield)
+{
+  // the last one first
+  for (auto it = uris.rbegin(); it != uris.rend(); ++it) {
+    FaceUri uri;
+    if (!uri.parse(*it)) {
+      continue;
+    }
+
+    LOG_DBG("Try " << uri);
+    if (!canonizeUri(uri, FACEURI_CANONIZE_TIMEOUT, yield)) {
+      continue;
+    }
+
+    auto response = startNfdCommand<nfd::FaceCreateCommand>(
+      nfd::ControlParameters().setUri(uri.toString()), yield);
+    if (response.getCode() == 409) {
+      LOG_DBG("face already exists");
+    }
+    if (response.getCode() == 200 || response.getCode() == 409) {
+      try {
+	face = nfd::ControlParameters(response.getBody());
+	return true;
+      }
+      catch (const tlv::Error& e) {
+	LOG_FAILURE("create face", "invalid response for " << uri << ": " << e.what());
+      }
+    }
+  }
+
+  LOG_FAILURE("create face", "all provided uris are not accessible");
+  return false;
 }
 
 void
@@ -170,6 +269,8 @@ AuthenticationServer::issueCertificate(const ControlParameters& params,
   if (!params.hasName() || !params.hasKey()) {
     return done(ControlResponse(0, "invalid parameters for issueCert").wireEncode());
   }
+  trace::Span span(params.hasTraceId() ? params.getTraceId() : trace::generateTraceId(),
+		   "issue-cert");
   
   auto anchorCert = getDefaultCertificate();
   auto newCert = generateDeviceCertificate(params.getName(), params.getKey(), anchorCert);
@@ -2,6 +2,7 @@
 #define NDN_IOT_AUTHENTICATION_SERVER_HPP
 
 #include "entity.hpp"
+#include "shard-ring.hpp"
 #include <ndn-cxx/mgmt/nfd/face-status.hpp>
 #include <ndn-cxx/net/face-uri.hpp>
 #include <ndn-cxx/mgmt/nfd/control-parameters.hpp>
@@ -11,10 +12,42 @@
 namespace ndn {
 namespace iot {
 
+/** @brief How an AuthenticationServer shares the onboarding with other processes
+ *
+ *  A front probes the devices added to it and hands each one, by a consistent hash of
+ *  its name, to a worker, which connects to the device and issues its certificate.  All
+ *  of them run under the same identity, thus the same anchor certificate.
+ */
+struct ShardOptions
+{
+  enum Role {
+    STANDALONE,
+    FRONT,
+    WORKER
+  };
+
+  Role role = STANDALONE;
+
+  /** @brief the number of workers
+   */
+  size_t nShards = 0;
+
+  /** @brief the index of this worker
+   */
+  size_t shardId = 0;
+};
+
 class AuthenticationServer : public Entity
 {
 public:
-  AuthenticationServer(const Name& name = "/home/as");
+  AuthenticationServer(const Name& name = "/home/as",
+		       const EntityOptions& options = EntityOptions(),
+		       const ShardOptions& shardOptions = ShardOptions());
+
+  /** @brief the prefix of the handoff commands to a worker
+   */
+  static Name
+  getShardPrefix(size_t shardId);
 
 public:
   void
@@ -25,40 +58,47 @@ public:
   issueCertificate(const ControlParameters& params,
 		   const ReplyWithContent& done);
   
-private: // probe
+private: // onboarding, each device in a coroutine of its own
   void
-  handleProbeResponse(const Block& content,
-		      const ReplyWithContent& done,
-		      const std::string& pin);
+  onboardDevice(const ControlParameters& params,
+		const ReplyWithContent& done,
+		boost::asio::yield_context yield);
 
-  typedef boost::function<void (const nfd::ControlParameters&)> CommandSucceedCallback;
+  /** @return the response to the add-device command
+   */
+  Block
+  enrollDevice(const Name& devName, const std::vector<std::string>& uris,
+	       const std::string& pin, trace::TraceId traceId,
+	       boost::asio::yield_context yield);
 
-  void
-  connectToDevice(std::vector<std::string> pendingUris,
-		  const CommandSucceedCallback& cbDeviceConnected,
-		  const ReplyWithContent& done);
-  
-  void
-  createFaceTowardDevice(const FaceUri& canonicalUri,
-			 std::vector<std::string> pendingUris,
-			 const CommandSucceedCallback& cbDeviceConnected,
-			 const ReplyWithContent& done);
+  /** @brief create a face toward the first URI that works, the last one first
+   */
+  bool
+  connectToDevice(const std::vector<std::string>& uris,
+		  nfd::ControlParameters& face,
+		  boost::asio::yield_context yield);
+
+private: // shard
+  Block
+  handOffDevice(const Name& devName, const std::vector<std::string>& uris,
+		const std::string& pin, trace::TraceId traceId,
+		boost::asio::yield_context yield);
 
   void
-  afterCreateFaceFailed(const nfd::ControlResponse& resp,
-			std::vector<std::string> pendingUris,
-			const CommandSucceedCallback& cbDeviceConnected,
-			const ReplyWithContent& done);
+  handleHandOff(const ControlParameters& params,
+		const ReplyWithContent& done);
 
   void
-  afterConnectToDevice(const nfd::ControlParameters& params,
-		       const Name& name,
-		       const ReplyWithContent& done);
+  rejectUnknownApplication(const Interest& interest);
 
 protected:
   security::v2::Certificate
   generateDeviceCertificate(const Name& keyName, const Block& pubKey,
 			    const security::v2::Certificate& anchor);
+
+private:
+  ShardOptions m_shardOptions;
+  ShardRing m_ring;
 };
 
 } // namespace iot
@@ -0,0 +1,46 @@
+#ifndef NDN_IOT_AWAIT_HPP
+#define NDN_IOT_AWAIT_HPP
+
+#include <boost/asio/spawn.hpp>
+#include <boost/version.hpp>
+
+#include <functional>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Suspend a coroutine until a callback-based operation completes
+ *
+ *  @p initiate starts the operation and is given the function to call with its outcome,
+ *  at most once; the coroutine of @p yield resumes with that outcome as the result.  The
+ *  operation may complete before @p initiate returns.  It must complete on the thread of
+ *  the io_service the coroutine was spawned on, as every callback of a Face does.
+ *
+ *  @code
+ *  boost::asio::spawn(ioService, [this] (boost::asio::yield_context yield) {
+ *    auto content = issueCommand(command, yield);
+ *    ...
+ *  });
+ *  @endcode
+ */
+template<typename T, typename Initiate>
+T
+await(boost::asio::yield_context yield, const Initiate& initiate)
+{
+#if BOOST_VERSION >= 106600
+  boost::asio::async_completion<boost::asio::yield_context, void(T)> completion(yield);
+  auto handler = completion.completion_handler;
+  initiate(std::function<void(T)>([handler] (T outcome) mutable { handler(outcome); }));
+  return completion.result.get();
+#else
+  typename boost::asio::handler_type<boost::asio::yield_context, void(T)>::type handler(yield);
+  boost::asio::async_result<decltype(handler)> result(handler);
+  initiate(std::function<void(T)>([handler] (T outcome) mutable { handler(outcome); }));
+  return result.get();
+#endif
+}
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_AWAIT_HPP
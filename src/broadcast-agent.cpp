@@ -1,40 +1,83 @@
 #include "broadcast-agent.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/security/key-chain.hpp>
 #include <ndn-cxx/mgmt/nfd/controller.hpp>
+#include <sstream>
 
 namespace ndn {
 namespace iot {
 
+NDN_IOT_LOG_INIT(broadcast);
+
 BroadcastAgent::BroadcastAgent(Face& face,
 			       KeyChain& keyChain,
-			       nfd::Controller& controller)
+			       nfd::Controller& controller,
+			       InterestAggregator& aggregator)
   : m_face(face)
   , m_keyChain(keyChain)
   , m_controller(controller)
+  , m_aggregator(aggregator)
 {
 }
 
 void
 BroadcastAgent::registerTopPrefix(const Name& prefix,
-				  const registerTopPrefixCallback& cbAfterRegistration)
+				  const registerTopPrefixCallback& cbAfterRegistration,
+				  const registerTopPrefixCallback& cbOnFailure)
+{
+  registerTopPrefixes({prefix}, cbAfterRegistration, cbOnFailure);
+}
+
+void
+BroadcastAgent::registerTopPrefixes(const std::vector<Name>& prefixes,
+				    const registerTopPrefixCallback& cbAfterRegistration,
+				    const registerTopPrefixCallback& cbOnFailure)
 {
   // TODO check overlap
+  m_topPrefixes.insert(m_topPrefixes.end(), prefixes.begin(), prefixes.end());
+  startRegistration(prefixes, cbAfterRegistration, cbOnFailure);
+}
+
+void
+BroadcastAgent::restoreTopPrefixes(const registerTopPrefixCallback& cbAfterRegistration,
+				   const registerTopPrefixCallback& cbOnFailure)
+{
+  if (m_topPrefixes.empty()) {
+    return cbAfterRegistration();
+  }
+  startRegistration(m_topPrefixes, cbAfterRegistration, cbOnFailure);
+}
+
+void
+BroadcastAgent::startRegistration(const std::vector<Name>& prefixes,
+				  const registerTopPrefixCallback& cbAfterRegistration,
+				  const registerTopPrefixCallback& cbOnFailure)
+{
+  auto context = make_shared<RegistrationContext>();
+  context->prefixes = prefixes;
+  context->nRoutes.assign(prefixes.size(), 0);
+  context->hasStrategy.assign(prefixes.size(), false);
+  context->nPending = prefixes.size();
+  context->cbAfterRegistration = cbAfterRegistration;
+  context->cbOnFailure = cbOnFailure;
+
+  // the strategy choice does not depend on the routes, so set it while fetching faces
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    setStrategy(context, i);
+  }
+
   nfd::FaceQueryFilter filter;
   filter.setLinkType(nfd::LINK_TYPE_MULTI_ACCESS);
 
-  nfd::ControlParameters registerParameters = nfd::ControlParameters()
-    .setName(prefix)
-    .setCost(1)
-    .setExpirationPeriod(time::milliseconds::max());
-  
+  ++context->nPending;
   m_controller.fetch<nfd::FaceQueryDataset>(
     filter,
-    bind(&BroadcastAgent::registerPrefixToFaces, this,
-	 registerParameters, _1, cbAfterRegistration),
-    [] (uint32_t code, const std::string& reason) {
+    bind(&BroadcastAgent::registerPrefixesToFaces, this, context, _1),
+    [this, context] (uint32_t code, const std::string& reason) {
       LOG_FAILURE("broadcast", "Error " << code << "when fetching multicast faces: " << reason);
+      afterRegistrationStep(context);
     });
 }
 
@@ -44,77 +87,196 @@ BroadcastAgent::broadcast(const Interest& interest,
 			  const NackCallback& cbOnNack,
 			  const TimeoutCallback& cbOnTimeout)
 {
-  m_face.expressInterest(interest, cbOnData, cbOnNack, cbOnTimeout);
-  LOG_INTEREST_OUT(interest);
+  m_aggregator.expressInterest(interest, cbOnData, cbOnNack, cbOnTimeout);
 }
 
 void
-BroadcastAgent::registerPrefixToFaces(const nfd::ControlParameters& params,
-				      const std::vector<nfd::FaceStatus>& dataset,
-				      const registerTopPrefixCallback& cbAfterRegistration)
+BroadcastAgent::collect(const Interest& interest,
+			const ResponderExtractor& extractResponder,
+			const CollectCallback& cbOnBatch,
+			time::milliseconds window,
+			size_t maxRounds)
 {
-  if (dataset.empty()) {
-    LOG_FAILURE("broadcast", "No multi-access face available");
-    return;
+  auto context = make_shared<CollectContext>();
+  context->interest = interest;
+  context->nRounds = 0;
+  context->startTime = time::steady_clock::now();
+  context->window = window;
+  context->maxRounds = maxRounds;
+  context->extractResponder = extractResponder;
+  context->cbOnBatch = cbOnBatch;
+
+  expressCollectRound(context);
+}
+
+bool
+BroadcastAgent::extractResponderFromContent(const Data& data, Name& responder)
+{
+  try {
+    auto content = data.getContent();
+    content.parse();
+    responder.wireDecode(content.get(tlv::Name));
+    return true;
+  }
+  catch (const tlv::Error&) {
+    return false;
   }
+}
 
-  m_nRegs = dataset.size();
-  m_nRegSuccess = 0;
-  m_nRegFailure = 0;
-
-  Name prefix = params.getName();  
-  for (const auto& faceStatus : dataset) {
-    auto registerParameters = params;
-    
-    m_controller.start<nfd::RibRegisterCommand>(
-      registerParameters.setFaceId(faceStatus.getFaceId()),
-      [this, prefix, cbAfterRegistration] (const nfd::ControlParameters&) {
-	++m_nRegSuccess;
-        afterPrefixRegistration(prefix, cbAfterRegistration);
-      },
-      [this, prefix, faceStatus, cbAfterRegistration] (const nfd::ControlResponse& resp) {
-	LOG_FAILURE("broadcast", "Error " << resp.getCode() << " in registering route to ["
-		    << faceStatus.getRemoteUri() << "]: " << resp.getText());
-	++m_nRegFailure;
-        afterPrefixRegistration(prefix, cbAfterRegistration);
-      });
+static name::Component
+makeResponderComponent(const Name& responder)
+{
+  const auto& wire = responder.wireEncode();
+  return name::Component(wire.wire(), wire.size());
+}
+
+bool
+BroadcastAgent::isResponderExcluded(const Interest& interest, const Name& self)
+{
+  const auto& exclude = interest.getExclude();
+  return !exclude.empty() && exclude.isExcluded(makeResponderComponent(self));
+}
+
+void
+BroadcastAgent::expressCollectRound(const shared_ptr<CollectContext>& context)
+{
+  Interest interest(context->interest);
+  if (!context->responders.empty()) {
+    interest.setExclude(context->responders);
   }
+  interest.refreshNonce();
+  interest.setInterestLifetime(context->window);
+  ++context->nRounds;
+
+  m_aggregator.expressInterest(interest,
+			       bind(&BroadcastAgent::onCollectedData, this, context, _2),
+			       [this, context] (const Interest&, const lp::Nack& nack) {
+				 std::ostringstream os;
+				 os << "NACK " << nack.getReason();
+				 finishCollection(context, os.str());
+			       },
+			       [this, context] (const Interest&) {
+				 finishCollection(context, "window closed");
+			       });
 }
-  
+
 void
-BroadcastAgent::afterPrefixRegistration(const Name& prefix,
-					const registerTopPrefixCallback& cbAfterRegistration)
+BroadcastAgent::onCollectedData(const shared_ptr<CollectContext>& context, const Data& data)
 {
-  if (m_nRegSuccess + m_nRegFailure < m_nRegs) {
-    return; // continue waiting
+  Name responder;
+  if (!context->extractResponder(data, responder)) {
+    LOG_FAILURE("broadcast", "can not tell the responder of " << data.getName());
+    return finishCollection(context, "unknown responder");
   }
-  if (m_nRegSuccess > 0) {
-    this->setStrategy(prefix, cbAfterRegistration);
+
+  auto component = makeResponderComponent(responder);
+  if (!context->responders.isExcluded(component)) {
+    context->responders.excludeOne(component);
+    context->replies.push_back(data);
+  }
+
+  if (context->nRounds >= context->maxRounds) {
+    return finishCollection(context, "too many rounds");
   }
-  else {
-    LOG_FAILURE("broadcast", "Cannot register prefix on any multicast face");
-  }  
+  expressCollectRound(context);
 }
 
 void
-BroadcastAgent::setStrategy(const Name& prefix,
-			    const registerTopPrefixCallback& cbAfterRegistration)
+BroadcastAgent::finishCollection(const shared_ptr<CollectContext>& context,
+				 const std::string& reason)
+{
+  auto elapsed = time::duration_cast<time::milliseconds>(time::steady_clock::now() -
+							 context->startTime);
+  LOG_INFO("collected " << context->replies.size() << " replies to "
+	   << context->interest.getName().getPrefix(1) << " in " << context->nRounds
+	   << " rounds, " << elapsed << " (" << reason << ")");
+
+  Metrics::increment(Metrics::BROADCAST_ROUNDS, context->nRounds);
+  Metrics::increment(Metrics::BROADCAST_REPLIES, context->replies.size());
+  Metrics::record(Metrics::REPLIES_PER_BROADCAST, context->replies.size());
+
+  context->cbOnBatch(context->replies);
+}
+
+void
+BroadcastAgent::registerPrefixesToFaces(const shared_ptr<RegistrationContext>& context,
+					const std::vector<nfd::FaceStatus>& dataset)
+{
+  if (dataset.empty()) {
+    LOG_FAILURE("broadcast", "No multi-access face available");
+    return afterRegistrationStep(context);
+  }
+
+  context->nPending += context->prefixes.size() * dataset.size();
+  for (size_t i = 0; i < context->prefixes.size(); ++i) {
+    for (const auto& faceStatus : dataset) {
+      nfd::ControlParameters registerParameters;
+      registerParameters
+	.setName(context->prefixes[i])
+	.setFaceId(faceStatus.getFaceId())
+	.setCost(1)
+	.setExpirationPeriod(time::milliseconds::max());
+
+      m_controller.start<nfd::RibRegisterCommand>(
+	registerParameters,
+	[this, context, i] (const nfd::ControlParameters&) {
+	  ++context->nRoutes[i];
+	  afterRegistrationStep(context);
+	},
+	[this, context, faceStatus] (const nfd::ControlResponse& resp) {
+	  LOG_FAILURE("broadcast", "Error " << resp.getCode() << " in registering route to ["
+		      << faceStatus.getRemoteUri() << "]: " << resp.getText());
+	  afterRegistrationStep(context);
+	});
+    }
+  }
+
+  // the face query itself is done
+  afterRegistrationStep(context);
+}
+
+void
+BroadcastAgent::setStrategy(const shared_ptr<RegistrationContext>& context, size_t index)
 {
   nfd::ControlParameters parameters;
   parameters
-    .setName(prefix)
+    .setName(context->prefixes[index])
     .setStrategy("/localhost/nfd/strategy/multicast");
-  
+
   m_controller.start<nfd::StrategyChoiceSetCommand>(
     parameters,
-    bind([cbAfterRegistration] {
-	LOG_DBG("Multicast faces are ready");
-	cbAfterRegistration();
-      }),
-    [this] (const nfd::ControlResponse& resp) {
+    [this, context, index] (const nfd::ControlParameters&) {
+      context->hasStrategy[index] = true;
+      afterRegistrationStep(context);
+    },
+    [this, context] (const nfd::ControlResponse& resp) {
       LOG_FAILURE("broadcast", "Error " << resp.getCode() << "when setting multicast strategy: "
-		  << resp.getText())
-    });  
+		  << resp.getText());
+      afterRegistrationStep(context);
+    });
+}
+
+void
+BroadcastAgent::afterRegistrationStep(const shared_ptr<RegistrationContext>& context)
+{
+  if (--context->nPending > 0) {
+    return; // continue waiting
+  }
+
+  for (size_t i = 0; i < context->prefixes.size(); ++i) {
+    if (context->nRoutes[i] == 0) {
+      LOG_FAILURE("broadcast", "Cannot register " << context->prefixes[i]
+		  << " on any multicast face");
+      return context->cbOnFailure();
+    }
+    if (!context->hasStrategy[i]) {
+      LOG_FAILURE("broadcast", "Cannot set the multicast strategy of " << context->prefixes[i]);
+      return context->cbOnFailure();
+    }
+  }
+
+  LOG_DBG("Multicast faces are ready");
+  context->cbAfterRegistration();
 }
 
 } // namespace iot
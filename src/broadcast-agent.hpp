@@ -1,6 +1,8 @@
 #ifndef NDN_IOT_BROADCAST_AGENT_HPP
 #define NDN_IOT_BROADCAST_AGENT_HPP
 
+#include "interest-aggregator.hpp"
+
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/security/key-chain.hpp>
 #include <ndn-cxx/mgmt/nfd/controller.hpp>
@@ -17,13 +19,36 @@ class BroadcastAgent
 public:
   BroadcastAgent(Face& face,
 		 KeyChain& keyChain,
-		 nfd::Controller& controller);
+		 nfd::Controller& controller,
+		 InterestAggregator& aggregator);
 
   typedef std::function<void(void)> registerTopPrefixCallback;
   
   void
   registerTopPrefix(const Name& prefix,
-		    const registerTopPrefixCallback& cbAfterRegistration = [] {});
+		    const registerTopPrefixCallback& cbAfterRegistration = [] {},
+		    const registerTopPrefixCallback& cbOnFailure = [] {});
+
+  /** @brief Register several prefixes on all multicast faces in one pipelined batch
+   *
+   *  The multicast strategy of every prefix is set in parallel with the face query and the
+   *  RIB registrations, which share one face query.  @p cbAfterRegistration is invoked once
+   *  every prefix is routed through at least one multicast face and has its strategy set,
+   *  and @p cbOnFailure otherwise, e.g. on a host without multicast face.
+   */
+  void
+  registerTopPrefixes(const std::vector<Name>& prefixes,
+		      const registerTopPrefixCallback& cbAfterRegistration = [] {},
+		      const registerTopPrefixCallback& cbOnFailure = [] {});
+
+  /** @brief Register every prefix registered so far again, e.g. after the forwarder
+   *         restarted, with its multicast faces under new IDs
+   *
+   *  Exactly one of @p cbAfterRegistration and @p cbOnFailure is invoked.
+   */
+  void
+  restoreTopPrefixes(const registerTopPrefixCallback& cbAfterRegistration,
+		     const registerTopPrefixCallback& cbOnFailure);
 
   void
   broadcast(const Interest& interest,
@@ -31,28 +56,91 @@ public:
 	    const NackCallback& cbOnNack,
 	    const TimeoutCallback& cbOnTimeout);
 
-private: 
+public: // collect
+  typedef boost::function<bool(const Data& data, Name& responder)> ResponderExtractor;
+  typedef boost::function<void(const std::vector<Data>& replies)> CollectCallback;
+
+  /** @brief Collect the replies of all neighbors to a broadcast Interest
+   *
+   *  The Face only delivers the first Data to an expressed Interest, so the Interest is
+   *  re-expressed round by round with the already seen responders in its Exclude, until
+   *  a round stays silent for @p window or @p maxRounds is reached.  All unique replies
+   *  are then delivered as one batch.
+   */
   void
-  registerPrefixToFaces(const nfd::ControlParameters& params,
-			const std::vector<nfd::FaceStatus>& dataset,
-			const registerTopPrefixCallback& cbAfterRegistration);
+  collect(const Interest& interest,
+	  const ResponderExtractor& extractResponder,
+	  const CollectCallback& cbOnBatch,
+	  time::milliseconds window = time::milliseconds(500),
+	  size_t maxRounds = 64);
+
+  /** @brief Get the responder name carried as the first Name in the Data content
+   */
+  static bool
+  extractResponderFromContent(const Data& data, Name& responder);
+
+  /** @return whether @p self is excluded by a collecting Interest, i.e. already heard
+   */
+  static bool
+  isResponderExcluded(const Interest& interest, const Name& self);
+
+private:
+  struct CollectContext
+  {
+    Interest interest;
+    Exclude responders;
+    std::vector<Data> replies;
+    size_t nRounds;
+    time::steady_clock::TimePoint startTime;
+    time::milliseconds window;
+    size_t maxRounds;
+    ResponderExtractor extractResponder;
+    CollectCallback cbOnBatch;
+  };
 
   void
-  afterPrefixRegistration(const Name& prefix,
-			  const registerTopPrefixCallback& cbAfterRegistration);
+  expressCollectRound(const shared_ptr<CollectContext>& context);
 
   void
-  setStrategy(const Name& prefix,
-	      const registerTopPrefixCallback& cbAfterRegistration);
-  
+  onCollectedData(const shared_ptr<CollectContext>& context, const Data& data);
+
+  void
+  finishCollection(const shared_ptr<CollectContext>& context, const std::string& reason);
+
+private: // registration
+  /** @brief state of one registerTopPrefixes or restoreTopPrefixes call
+   */
+  struct RegistrationContext
+  {
+    std::vector<Name> prefixes;
+    std::vector<size_t> nRoutes;
+    std::vector<bool> hasStrategy;
+    size_t nPending;
+    registerTopPrefixCallback cbAfterRegistration;
+    registerTopPrefixCallback cbOnFailure;
+  };
+
+  void
+  startRegistration(const std::vector<Name>& prefixes,
+		    const registerTopPrefixCallback& cbAfterRegistration,
+		    const registerTopPrefixCallback& cbOnFailure);
+
+  void
+  registerPrefixesToFaces(const shared_ptr<RegistrationContext>& context,
+			  const std::vector<nfd::FaceStatus>& dataset);
+
+  void
+  setStrategy(const shared_ptr<RegistrationContext>& context, size_t index);
+
+  void
+  afterRegistrationStep(const shared_ptr<RegistrationContext>& context);
+
 private:
   Face& m_face;
   KeyChain& m_keyChain;
   nfd::Controller& m_controller;
-
-  int m_nRegs = 0;
-  int m_nRegSuccess = 0;
-  int m_nRegFailure = 0;
+  InterestAggregator& m_aggregator;
+  std::vector<Name> m_topPrefixes;
 };
 
 } // namespace iot
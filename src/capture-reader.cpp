@@ -0,0 +1,214 @@
+#include "capture-reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ndn {
+namespace iot {
+namespace capture {
+
+template<typename T>
+static T
+getLittleEndian(const uint8_t* buffer)
+{
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<T>(buffer[i]) << (8 * i);
+  }
+  return value;
+}
+
+Reader::Reader(const std::string& path)
+  : m_begin(nullptr)
+  , m_size(0)
+  , m_position(FILE_HEADER_SIZE)
+  , m_segment(0)
+  , m_startTime(0)
+  , m_hasTrailer(false)
+{
+  int fd = ::open(path.data(), O_RDONLY);
+  if (fd < 0) {
+    throw Error("cannot open " + path);
+  }
+
+  struct stat status;
+  if (::fstat(fd, &status) < 0 || static_cast<size_t>(status.st_size) < FILE_HEADER_SIZE) {
+    ::close(fd);
+    throw Error(path + " is too short to be a capture");
+  }
+
+  m_size = status.st_size;
+  void* mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw Error("cannot map " + path);
+  }
+  m_begin = static_cast<const uint8_t*>(mapped);
+  ::madvise(mapped, m_size, MADV_SEQUENTIAL);
+
+  if (std::memcmp(m_begin, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+      getLittleEndian<uint16_t>(m_begin + 8) != FORMAT_VERSION) {
+    ::munmap(mapped, m_size);
+    throw Error(path + " is not a capture of version " + std::to_string(FORMAT_VERSION));
+  }
+  m_position = getLittleEndian<uint16_t>(m_begin + 10);
+  m_segment = getLittleEndian<uint32_t>(m_begin + 12);
+  m_startTime = getLittleEndian<uint64_t>(m_begin + 16);
+
+  const uint8_t* trailer = m_begin + m_size - TRAILER_SIZE;
+  if (m_size >= FILE_HEADER_SIZE + TRAILER_SIZE &&
+      std::memcmp(trailer, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) == 0) {
+    m_hasTrailer = true;
+    loadIndexChain(getLittleEndian<uint64_t>(trailer + 8));
+  }
+  else {
+    scanIndex();
+  }
+}
+
+Reader::~Reader()
+{
+  ::munmap(const_cast<uint8_t*>(m_begin), m_size);
+}
+
+uint64_t
+Reader::getEnd() const
+{
+  return m_hasTrailer ? m_size - TRAILER_SIZE : m_size;
+}
+
+bool
+Reader::next(Record& record)
+{
+  uint64_t end = getEnd();
+  while (m_position + RECORD_HEADER_SIZE <= end) {
+    const uint8_t* header = m_begin + m_position;
+    uint32_t length = getLittleEndian<uint32_t>(header + 4);
+    if (m_position + RECORD_HEADER_SIZE + length > end) {
+      break; // truncated by a writer that did not close the segment
+    }
+
+    const uint8_t* payload = header + RECORD_HEADER_SIZE;
+    m_position += RECORD_HEADER_SIZE + length;
+
+    switch (header[0]) {
+    case RECORD_PACKET:
+      record.direction = static_cast<Direction>(header[1]);
+      record.tag = getLittleEndian<uint16_t>(header + 2);
+      record.timestamp = getLittleEndian<uint64_t>(header + 8);
+      record.wire = payload;
+      record.size = length;
+      return true;
+    case RECORD_TAG:
+      if (length >= 2) {
+	m_tags[getLittleEndian<uint16_t>(payload)] =
+	  std::string(reinterpret_cast<const char*>(payload) + 2, length - 2);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  m_position = end;
+  return false;
+}
+
+void
+Reader::seek(uint64_t timestamp)
+{
+  auto it = std::lower_bound(m_index.begin(), m_index.end(), timestamp,
+			     [] (const IndexEntry& entry, uint64_t ts) {
+			       return entry.timestamp < ts;
+			     });
+  m_position = it == m_index.end() ? getEnd() : it->offset;
+}
+
+std::string
+Reader::getEntity(uint16_t tag) const
+{
+  auto it = m_tags.find(tag);
+  return it == m_tags.end() ? "tag-" + std::to_string(tag) : it->second;
+}
+
+void
+Reader::loadIndexChain(uint64_t lastIndex)
+{
+  std::vector<std::vector<IndexEntry>> blocks;
+  uint64_t offset = lastIndex;
+  while (offset >= FILE_HEADER_SIZE && offset + RECORD_HEADER_SIZE + 14 <= getEnd()) {
+    const uint8_t* header = m_begin + offset;
+    uint32_t length = getLittleEndian<uint32_t>(header + 4);
+    if (header[0] != RECORD_INDEX || offset + RECORD_HEADER_SIZE + length > getEnd()) {
+      break;
+    }
+
+    const uint8_t* payload = header + RECORD_HEADER_SIZE;
+    const uint8_t* payloadEnd = payload + length;
+    uint64_t previous = getLittleEndian<uint64_t>(payload);
+    uint32_t count = getLittleEndian<uint32_t>(payload + 8);
+    const uint8_t* entry = payload + 12;
+    // count is untrusted, so it is compared without a product that could wrap
+    if (length < 14 || count > static_cast<size_t>(payloadEnd - entry - 2) / 16) {
+      break;
+    }
+
+    blocks.emplace_back();
+    for (uint32_t i = 0; i < count; ++i, entry += 16) {
+      blocks.back().push_back({getLittleEndian<uint64_t>(entry),
+			       getLittleEndian<uint64_t>(entry + 8)});
+    }
+
+    uint16_t nTags = getLittleEndian<uint16_t>(entry);
+    entry += 2;
+    for (uint16_t i = 0; i < nTags && entry + 4 <= payloadEnd; ++i) {
+      uint16_t tag = getLittleEndian<uint16_t>(entry);
+      uint16_t size = getLittleEndian<uint16_t>(entry + 2);
+      if (entry + 4 + size > payloadEnd) {
+	break;
+      }
+      m_tags[tag] = std::string(reinterpret_cast<const char*>(entry) + 4, size);
+      entry += 4 + size;
+    }
+
+    if (previous >= offset) {
+      break;
+    }
+    offset = previous;
+  }
+
+  for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+    m_index.insert(m_index.end(), it->begin(), it->end());
+  }
+}
+
+void
+Reader::scanIndex()
+{
+  uint64_t offset = m_position;
+  while (offset + RECORD_HEADER_SIZE <= m_size) {
+    const uint8_t* header = m_begin + offset;
+    uint32_t length = getLittleEndian<uint32_t>(header + 4);
+    if (offset + RECORD_HEADER_SIZE + length > m_size) {
+      break;
+    }
+
+    const uint8_t* payload = header + RECORD_HEADER_SIZE;
+    if (header[0] == RECORD_PACKET) {
+      m_index.push_back({getLittleEndian<uint64_t>(header + 8), offset});
+    }
+    else if (header[0] == RECORD_TAG && length >= 2) {
+      m_tags[getLittleEndian<uint16_t>(payload)] =
+	std::string(reinterpret_cast<const char*>(payload) + 2, length - 2);
+    }
+    offset += RECORD_HEADER_SIZE + length;
+  }
+}
+
+} // namespace capture
+} // namespace iot
+} // namespace ndn
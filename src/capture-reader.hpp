@@ -0,0 +1,123 @@
+#ifndef NDN_IOT_CAPTURE_READER_HPP
+#define NDN_IOT_CAPTURE_READER_HPP
+
+#include "packet-capture.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+namespace capture {
+
+struct Record
+{
+  Direction direction;
+  uint16_t tag;
+  uint64_t timestamp;
+  const uint8_t* wire;
+  size_t size;
+};
+
+/** @brief Memory-mapped reader of one capture segment written by capture::Writer
+ *
+ *  The index is loaded from the INDEX chain of a cleanly closed segment; a segment
+ *  whose writer died is indexed by hopping over the record headers instead.
+ */
+class Reader
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  explicit
+  Reader(const std::string& path);
+
+  ~Reader();
+
+  Reader(const Reader&) = delete;
+
+  Reader&
+  operator=(const Reader&) = delete;
+
+  /** @brief Read the next PACKET record
+   *  @return false at the end of the segment
+   *  @note record.wire points into the mapped file and stays valid while the Reader lives
+   */
+  bool
+  next(Record& record);
+
+  /** @brief Move to the first packet captured at or after @p timestamp
+   */
+  void
+  seek(uint64_t timestamp);
+
+  void
+  rewind()
+  {
+    m_position = FILE_HEADER_SIZE;
+  }
+
+  std::string
+  getEntity(uint16_t tag) const;
+
+  uint32_t
+  getSegment() const
+  {
+    return m_segment;
+  }
+
+  uint64_t
+  getStartTime() const
+  {
+    return m_startTime;
+  }
+
+  const std::vector<IndexEntry>&
+  getIndex() const
+  {
+    return m_index;
+  }
+
+  bool
+  isIndexed() const
+  {
+    return m_hasTrailer;
+  }
+
+private:
+  void
+  loadIndexChain(uint64_t lastIndex);
+
+  void
+  scanIndex();
+
+  uint64_t
+  getEnd() const;
+
+private:
+  const uint8_t* m_begin;
+  size_t m_size;
+  uint64_t m_position;
+
+  uint32_t m_segment;
+  uint64_t m_startTime;
+  bool m_hasTrailer;
+  std::vector<IndexEntry> m_index;
+  std::map<uint16_t, std::string> m_tags;
+};
+
+} // namespace capture
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_CAPTURE_READER_HPP
@@ -0,0 +1,89 @@
+#include "command-dispatcher.hpp"
+
+namespace ndn {
+namespace iot {
+
+CommandDispatcher::CommandDispatcher()
+  : m_size(0)
+{
+}
+
+bool
+CommandDispatcher::insert(const Name& prefix, size_t topPrefixSize, const Handler& handler)
+{
+  auto node = &m_root;
+  for (const auto& component : prefix) {
+    auto& child = node->children[component];
+    if (child == nullptr) {
+      child = make_unique<Node>();
+    }
+    node = child.get();
+  }
+
+  bool isNew = node->handler.empty();
+  node->handler = handler;
+  node->topPrefixSize = topPrefixSize;
+  if (isNew) {
+    ++m_size;
+  }
+  return isNew;
+}
+
+bool
+CommandDispatcher::erase(const Name& prefix)
+{
+  return erase(m_root, prefix, 0);
+}
+
+bool
+CommandDispatcher::erase(Node& node, const Name& prefix, size_t depth)
+{
+  if (depth == prefix.size()) {
+    if (node.handler.empty()) {
+      return false;
+    }
+    node.handler.clear();
+    --m_size;
+    return true;
+  }
+
+  auto it = node.children.find(prefix[depth]);
+  if (it == node.children.end() || !erase(*it->second, prefix, depth + 1)) {
+    return false;
+  }
+
+  // prune the branch left without handlers
+  if (it->second->handler.empty() && it->second->children.empty()) {
+    node.children.erase(it);
+  }
+  return true;
+}
+
+bool
+CommandDispatcher::dispatch(size_t topPrefixSize, const Interest& interest) const
+{
+  const auto& name = interest.getName();
+  const Node* match = m_root.handler.empty() ? nullptr : &m_root;
+  auto node = &m_root;
+  for (const auto& component : name) {
+    auto it = node->children.find(component);
+    if (it == node->children.end()) {
+      break;
+    }
+    node = it->second.get();
+    if (!node->handler.empty()) {
+      match = node;
+    }
+  }
+
+  if (match == nullptr || match->topPrefixSize != topPrefixSize) {
+    return false;
+  }
+  // a copy, as the handler may unregister itself
+  auto handler = match->handler;
+  handler(interest);
+  return true;
+}
+
+} // namespace iot
+} // namespace ndn
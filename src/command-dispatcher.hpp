@@ -0,0 +1,72 @@
+#ifndef NDN_IOT_COMMAND_DISPATCHER_HPP
+#define NDN_IOT_COMMAND_DISPATCHER_HPP
+
+#include <ndn-cxx/interest.hpp>
+
+#include <boost/function.hpp>
+
+#include <map>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Name trie from command prefixes to their handlers
+ *
+ *  An Entity sets one Interest filter per top prefix and dispatches through here to the
+ *  handler of the longest matching prefix, with one child lookup per name component
+ *  whatever the number of handlers.  Every handler belongs to a top prefix, and only
+ *  the filter of that top prefix dispatches to it, so an Interest under nested top
+ *  prefixes still reaches its handler once.
+ */
+class CommandDispatcher : noncopyable
+{
+public:
+  typedef boost::function<void(const Interest& interest)> Handler;
+
+  CommandDispatcher();
+
+  /** @brief add or replace the handler of @p prefix, under the top prefix made of its
+   *         first @p topPrefixSize components
+   *  @return whether the handler is new
+   */
+  bool
+  insert(const Name& prefix, size_t topPrefixSize, const Handler& handler);
+
+  /** @return whether there was a handler of @p prefix
+   */
+  bool
+  erase(const Name& prefix);
+
+  /** @brief call the handler of the longest prefix of the Interest name, if it belongs
+   *         to the top prefix of @p topPrefixSize components
+   *  @return whether a handler was called
+   */
+  bool
+  dispatch(size_t topPrefixSize, const Interest& interest) const;
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+private:
+  struct Node
+  {
+    std::map<name::Component, unique_ptr<Node>> children;
+    Handler handler;
+    size_t topPrefixSize = 0;
+  };
+
+  bool
+  erase(Node& node, const Name& prefix, size_t depth);
+
+private:
+  Node m_root;
+  size_t m_size;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_COMMAND_DISPATCHER_HPP
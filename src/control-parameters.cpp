@@ -124,6 +124,54 @@ ControlParameters::setKey(const Buffer& key)
   return setFiled(tlv::iot::PublicKey, key.buf(), key.size());
 }
 
+bool
+ControlParameters::hasDeviceUris() const
+{
+  return hasFiled(tlv::iot::DeviceUris);
+}
+
+std::vector<std::string>
+ControlParameters::getDeviceUris() const
+{
+  auto block = getFiled(tlv::iot::DeviceUris);
+  block.parse();
+
+  std::vector<std::string> uris;
+  for (const auto& element : block.elements()) {
+    uris.push_back(readString(element));
+  }
+  return uris;
+}
+
+ControlParameters&
+ControlParameters::setDeviceUris(const std::vector<std::string>& uris)
+{
+  auto block = makeEmptyBlock(tlv::iot::DeviceUris);
+  for (const auto& uri : uris) {
+    block.push_back(makeStringBlock(tlv::iot::DeviceUri, uri));
+  }
+  block.encode();
+  return setFiled(block);
+}
+
+bool
+ControlParameters::hasTraceId() const
+{
+  return hasFiled(tlv::iot::TraceId);
+}
+
+uint64_t
+ControlParameters::getTraceId() const
+{
+  return getIntegerFiled(tlv::iot::TraceId);
+}
+
+ControlParameters&
+ControlParameters::setTraceId(uint64_t traceId)
+{
+  return setFiled(tlv::iot::TraceId, traceId);
+}
+
 bool
 ControlParameters::hasFiled(uint32_t type) const
 {
@@ -21,7 +21,13 @@ enum {
   KeyName,
   PublicKey,
   TrustAnchor,
-  Certificate
+  Certificate,
+  Metric,
+  MetricName,
+  MetricValue,
+  MetricBucket,
+  MetricBucketBound,
+  TraceId
 };
 
 }
@@ -98,6 +104,24 @@ public:
 
   ControlParameters&
   setKey(const Buffer& key);
+
+  bool
+  hasDeviceUris() const;
+
+  std::vector<std::string>
+  getDeviceUris() const;
+
+  ControlParameters&
+  setDeviceUris(const std::vector<std::string>& uris);
+
+  bool
+  hasTraceId() const;
+
+  uint64_t
+  getTraceId() const;
+
+  ControlParameters&
+  setTraceId(uint64_t traceId);
   
 
 protected:
@@ -9,40 +9,133 @@
 namespace ndn {
 namespace iot {
 
-DeviceController::DeviceController(const std::string& pin, const Name& name)
-  : Entity(name, true)
+NDN_IOT_LOG_INIT(controller);
+
+/** @brief the remote end of a face without its port, which differs per TCP connection
+ */
+static std::string
+getHost(const std::string& uri)
+{
+  FaceUri faceUri;
+  if (!faceUri.parse(uri)) {
+    return uri;
+  }
+  return faceUri.getScheme() + "://" + faceUri.getHost();
+}
+
+DeviceController::DeviceController(const std::string& pin, const Name& name,
+				   const EntityOptions& options)
+  : Entity(name, true, options)
   , m_pin(pin)
   , m_faceMonitor(m_face)
   , m_asFaceId(0)
+  , m_traceId(0)
+  , m_isDiscoveryScheduled(false)
+  , m_discovery(options.discovery)
+  , m_nProbesSent(0)
+  , m_nProbesSuppressed(0)
 {
   LOG_WELCOME("IoT Device Controller", m_name);
   
   registerCommandHandler("localhop", "probe-device",
   			 bind(&DeviceController::handleProbe, this, _1, _2, _3),
   			 SecurityOptions().addOption(m_pin));
+
+  m_faceMonitor.onNotification.connect(bind(&DeviceController::handleFaceEvent, this, _1));
     
-  m_agent.registerTopPrefix("/localhop/probe-device",
-			    bind(&DeviceController::discovery, this));
+  // every multicast prefix of the device in one batch
+  auto probing = deferReady();
+  m_agent.registerTopPrefixes({"/localhop/probe-device"},
+			      [this, probing] {
+				probing();
+				scheduleDiscovery(true);
+			      },
+			      [probing] {
+				LOG_FAILURE("device", "no multicast route to probe or discover, "
+					    << "ready without");
+				probing();
+			      });
+}
+
+void
+DeviceController::scheduleDiscovery(bool reset)
+{
+  if (reset) {
+    m_discovery.reset();
+    if (m_isDiscoveryScheduled) {
+      m_scheduler.cancelEvent(m_discoveryEvent);
+      m_isDiscoveryScheduled = false;
+    }
+  }
+
+  if (m_isDiscoveryScheduled) {
+    return;
+  }
+
+  m_discoveryScheduledAt = time::steady_clock::now();
+  m_isDiscoveryScheduled = true;
+  m_discoveryEvent = m_scheduler.scheduleEvent(m_discovery.getDelay(),
+					       m_loopMonitor.wrap("DeviceController::onDiscoveryTimer",
+								  bind(&DeviceController::onDiscoveryTimer,
+								       this)));
+}
+
+void
+DeviceController::onDiscoveryTimer()
+{
+  m_isDiscoveryScheduled = false;
+
+  if (m_discovery.isSuppressed(m_discoveryScheduledAt, m_lastOverheardProbe)) {
+    ++m_nProbesSuppressed;
+    LOG_DBG("a neighbor just probed, suppress discovery (" << m_nProbesSuppressed
+	    << " suppressed, " << m_nProbesSent << " sent)");
+    return afterDiscovery(false);
+  }
+
+  discovery();
+}
+
+void
+DeviceController::afterDiscovery(bool hasNewNeighbor)
+{
+  m_discovery.afterRound(hasNewNeighbor);
+  scheduleDiscovery();
 }
 
 void
 DeviceController::discovery()
 {
   LOG_INFO("Start discovery other devices");
+  ++m_nProbesSent;
+
+  m_agent.collect(makeCommand("/localhop/probe-device",
+			      ControlParameters().setName(m_name),
+			      [this] (Interest& interest, KeyChain& keyChain) {
+				m_keyChain.sign(interest,
+						signingByIdentity(getIdentity()));
+			      }),
+		  &BroadcastAgent::extractResponderFromContent,
+		  m_loopMonitor.wrap("DeviceController::onDiscoveredDevices",
+				     bind(&DeviceController::onDiscoveredDevices, this, _1)));
+}
+
+void
+DeviceController::onDiscoveredDevices(const std::vector<Data>& replies)
+{
+  if (replies.empty()) {
+    LOG_FAILURE("discovery", "No device answered, you may not be trusted yet");
+  }
+
+  bool hasNewNeighbor = false;
+  for (const auto& data : replies) {
+    Name devName;
+    if (BroadcastAgent::extractResponderFromContent(data, devName)) {
+      hasNewNeighbor |= m_neighbors.insert(devName).second;
+    }
+    onDiscoveredDevice(data);
+  }
 
-  m_agent.broadcast(makeCommand("/localhop/probe-device",
-				ControlParameters().setName(m_name),
-				[this] (Interest& interest, KeyChain& keyChain) {
-				  m_keyChain.sign(interest,
-						  signingByIdentity(m_identity));
-				}),
-		    bind(&DeviceController::onDiscoveredDevice, this, _2),
-		    [] (const Interest&, const lp::Nack& nack) {
-		      LOG_FAILURE("discovery", "NACK: " << nack.getReason());
-		    },
-		    [] (const Interest&) {
-		      LOG_FAILURE("discovery", "You are not trusted yet");
-		    });
+  afterDiscovery(hasNewNeighbor);
 }
 
 void
@@ -70,7 +163,7 @@ DeviceController::onDiscoveredDevice(const Data& data)
 void
 DeviceController::handleProbe(const ControlParameters& parameters,
 			      const ReplyWithContent& done,
-			      SecurityOptions options)
+			      const SecurityOptions& options)
 {
   if (!parameters.hasName()) {
     return done(ControlResponse(0, "prober name is missing").wireEncode());
@@ -87,16 +180,41 @@ DeviceController::handleProbe(const ControlParameters& parameters,
       done(ControlResponse(code, reason).wireEncode());
     });
 
+  if (options.getVerificationType() == SecurityOptions::IDENTITY) {
+    // a neighbor is running discovery, which suppresses our own next round
+    m_lastOverheardProbe = time::steady_clock::now();
+    m_neighbors.insert(parameters.getName());
+  }
+
   if (options.getVerificationType() == SecurityOptions::HMAC) {
     LOG_STEP(1.2, "Handle probing Interest");
-    LOG_DBG("start monitor the face changes");
-    m_faceMonitor.onNotification.connect(bind(&DeviceController::handleFaceCreation, this,
-					      _1, parameters.getName()));
+    m_traceId = parameters.hasTraceId() ? parameters.getTraceId() : trace::generateTraceId();
+    m_enrollment = make_unique<trace::Span>(m_traceId, "enroll");
+    m_faceCreation = make_unique<trace::Span>(m_traceId, "face-create");
 
+    LOG_DBG("start monitor the face changes");
+    m_asName = parameters.getName();
     m_faceMonitor.start();
   }
 }
 
+void
+DeviceController::handleFaceEvent(const nfd::FaceEventNotification& notification)
+{
+  if (notification.getKind() == nfd::FACE_EVENT_DESTROYED &&
+      notification.getFaceId() == m_asFaceId) {
+    LOG_DBG("face " << m_asFaceId << " toward the AS is gone, wait for the AS to reconnect");
+    m_forwarderState.removeFace(m_asFaceId);
+    m_asFaceId = 0;
+  }
+  else if (m_faceCreation != nullptr) {
+    handleFaceCreation(notification, m_asName);
+  }
+  else {
+    handleAsReconnection(notification);
+  }
+}
+
 void
 DeviceController::handleFaceCreation(const nfd::FaceEventNotification& notification,
 				     const Name& name)
@@ -106,9 +224,13 @@ DeviceController::handleFaceCreation(const nfd::FaceEventNotification& notificat
       notification.getFacePersistency() == nfd::FACE_PERSISTENCY_ON_DEMAND) {
 
       LOG_DBG("new notification of face creation: " << notification.getFaceId());
-      m_createdFaces.push_back(notification.getFaceId());
+      // destroyed on exit, but created by the AS, so not created again after a restart
+      m_forwarderState.addFace(notification.getFaceId(), notification.getRemoteUri(), false);
+      m_faceCreation.reset();
 
-      auto onFailure = [] (const nfd::ControlResponse& resp) {
+      auto registration = make_shared<trace::Span>(m_traceId, "rib-register");
+      auto onFailure = [registration] (const nfd::ControlResponse& resp) {
+	registration->end();
 	LOG_FAILURE("register route", "Error " << resp.getCode()
 		    << " when registering rout to the created face: "
 		    << resp.getText());
@@ -116,34 +238,60 @@ DeviceController::handleFaceCreation(const nfd::FaceEventNotification& notificat
 
       LOG_DBG("register " << name << " to face: " << notification.getFaceId());
       m_asFaceId = notification.getFaceId();
-      registerPrefixOnFace("/iot", notification.getFaceId(),
-			   bind(&DeviceController::applyForCertificate, this,
-				name, notification.getFaceId()),
+      m_asHost = getHost(notification.getRemoteUri());
+      auto faceId = notification.getFaceId();
+      registerPrefixOnFace("/iot", faceId,
+			   [this, name, faceId, registration] (const nfd::ControlParameters&) {
+			     registration->end();
+			     applyForCertificate(name, faceId);
+			   },
 			   onFailure);
-
-      m_faceMonitor.stop();
+      // kept running, to route /iot again when the AS reconnects
     }  
 }
 
+void
+DeviceController::handleAsReconnection(const nfd::FaceEventNotification& notification)
+{
+  if (notification.getKind() != nfd::FACE_EVENT_CREATED || m_asFaceId != 0 ||
+      m_asHost.empty() || getHost(notification.getRemoteUri()) != m_asHost ||
+      notification.getFacePersistency() != nfd::FACE_PERSISTENCY_ON_DEMAND) {
+    return;
+  }
+
+  auto faceId = notification.getFaceId();
+  LOG_DBG("the AS reconnected, register /iot to face: " << faceId);
+  m_forwarderState.addFace(faceId, notification.getRemoteUri(), false);
+  m_asFaceId = faceId;
+  registerPrefixOnFace("/iot", faceId,
+		       bind([] {}),
+		       [] (const nfd::ControlResponse& resp) {
+			 LOG_FAILURE("register route", "Error " << resp.getCode()
+				     << " when registering /iot toward the AS again: "
+				     << resp.getText());
+		       });
+}
+
 void
 DeviceController::applyForCertificate(const Name& name, uint64_t faceId)
 {
   LOG_STEP(2.1, "Apply AS-signed certificate from " << name);
 
-  security::Key key;
-  try {
-    key = m_identity.getDefaultKey();
-  }
-  catch (const security::Pib::Error&) {
-    key = m_keyChain.createKey(m_identity);
-  }
+  trace::Span keyCreation(m_traceId, "key-create");
+  auto key = getDefaultKey();
+  keyCreation.end();
 
   auto prefix = Name(name).append("apply-cert").append(m_name);
-  auto params = ControlParameters().setName(key.getName()).setKey(key.getPublicKey());
+  auto params = ControlParameters().setName(key.getName()).setKey(key.getPublicKey())
+    .setTraceId(m_traceId);
 
+  auto keyName = key.getName();
+  auto application = make_shared<trace::Span>(m_traceId, "apply-cert");
   issueCommand(makeCommand(prefix, params, bind(&hmac::signInterest, _1, m_pin)),
-	       bind(&DeviceController::handleApplyResponse, this,
-		    key.getName(), faceId, _1),
+	       [this, keyName, faceId, application] (const Block& content) {
+		 application->end();
+		 handleApplyResponse(keyName, faceId, content);
+	       },
 	       bind(&hmac::verifyData, _1, m_pin));
 }
 
@@ -155,14 +303,18 @@ DeviceController::handleApplyResponse(const Name& keyName, uint64_t faceId,
     security::v2::Certificate anchorCert(content.blockFromValue());
     LOG_STEP(2.2, "Receive and Set trust anchor: " << anchorCert.getKeyName());
     
-    m_certificates[anchorCert.getKeyName()] = anchorCert;
+    storeCertificate(anchorCert);
 
+    auto registration = make_shared<trace::Span>(m_traceId, "rib-register");
     registerPrefixOnFace(keyName, faceId,
-			 bind(&DeviceController::requestCertificate, this,
-			      keyName),
-			 bind([] {
-			     LOG_FAILURE("register route", "fail");
-			   }));
+			 [this, keyName, registration] (const nfd::ControlParameters&) {
+			   registration->end();
+			   requestCertificate(keyName);
+			 },
+			 [registration] (const nfd::ControlResponse&) {
+			   registration->end();
+			   LOG_FAILURE("register route", "fail");
+			 });
  
   }
   catch (const tlv::Error& e) {
@@ -176,25 +328,30 @@ DeviceController::requestCertificate(const Name& keyName)
   LOG_STEP(3, "Request for AS signed certificate: " << keyName);
   
   Interest interest(keyName);
-  LOG_INTEREST_OUT(interest);
   
-  m_face.expressInterest(interest,
-			 [this, keyName] (const Interest&, const Data& data) {
-			   LOG_DATA_IN(data);
-			   auto key = m_identity.getKey(keyName);
-			   security::v2::Certificate cert(data);
+  auto fetching = make_shared<trace::Span>(m_traceId, "cert-fetch");
+  m_aggregator.expressInterest(interest,
+			       [this, keyName, fetching] (const Interest&, const Data& data) {
+				 fetching->end();
+				 security::v2::Certificate cert(data);
+				 {
+				   Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
+				   auto key = getIdentity().getKey(keyName);
+				   m_keyChain.setDefaultCertificate(key, cert);
+				 }
+				 LOG_DBG("new cert installed " << cert.getName());
+				 m_enrollment.reset();
 
-			   m_keyChain.setDefaultCertificate(key, cert);
-			   LOG_DBG("new cert installed " << cert.getName());
-
-			   discovery();
-			 },
-			 [] (const Interest&, const lp::Nack& nack) {
-			   LOG_FAILURE("request for cert", "Nack " << nack.getReason());
-			 },
-			 [] (const Interest&) {
-			   LOG_FAILURE("request for cert", "Timeout");
-			 });  
+				 scheduleDiscovery(true);
+			       },
+			       [fetching] (const Interest&, const lp::Nack& nack) {
+				 fetching->end();
+				 LOG_FAILURE("request for cert", "Nack " << nack.getReason());
+			       },
+			       [fetching] (const Interest&) {
+				 fetching->end();
+				 LOG_FAILURE("request for cert", "Timeout");
+			       });
 }
 
 void
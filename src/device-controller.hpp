@@ -6,6 +6,8 @@
 #include <ndn-cxx/mgmt/nfd/face-monitor.hpp>
 #include <ndn-cxx/face.hpp>
 
+#include <set>
+
 namespace ndn {
 namespace iot {
 
@@ -13,13 +15,14 @@ class DeviceController : public Entity
 {
 public:
   DeviceController(const std::string& pin,
-		   const Name& name = "/home/controller");
+		   const Name& name = "/home/controller",
+		   const EntityOptions& options = EntityOptions());
 
 public:
   void
   handleProbe(const ControlParameters& parameters,
 	      const ReplyWithContent& done,
-	      SecurityOptions options);
+	      const SecurityOptions& options);
 
   void
   onCertificateInterest(const Interest& interest);
@@ -27,17 +30,42 @@ public:
   void
   discovery();
 
+  /** @brief Schedule a discovery round as told by the DiscoveryPolicy
+   *
+   *  @param reset restart from the minimal interval, e.g. after the trust state changed
+   */
+  void
+  scheduleDiscovery(bool reset = false);
+
   void
   onDiscoveredDevice(const Data& data);
 
+  void
+  onDiscoveredDevices(const std::vector<Data>& replies);
+
 private:
+  void
+  onDiscoveryTimer();
+
+  void
+  afterDiscovery(bool hasNewNeighbor);
+
   void
   makeProbeResponse(const std::vector<nfd::FaceStatus>& dataset,
 		    const ReplyWithContent& done);
 
+  void
+  handleFaceEvent(const nfd::FaceEventNotification& notification);
+
   void
   handleFaceCreation(const nfd::FaceEventNotification& notification,
 		     const Name& name);
+
+  /** @brief route /iot again through the face the AS opened after its last one closed,
+   *         e.g. once the AS destroyed it for idleness
+   */
+  void
+  handleAsReconnection(const nfd::FaceEventNotification& notification);
   
   Block
   packageAccessibleUris(const std::vector<nfd::FaceStatus>& dataset);
@@ -54,7 +82,22 @@ private:
 private:
   std::string m_pin;
   nfd::FaceMonitor m_faceMonitor;
+  Name m_asName;
+  std::string m_asHost; // scheme and host of the faces the AS opens, without the port
   uint64_t m_asFaceId;
+
+  trace::TraceId m_traceId;
+  unique_ptr<trace::Span> m_enrollment;
+  unique_ptr<trace::Span> m_faceCreation;
+
+  std::set<Name> m_neighbors;
+  util::scheduler::EventId m_discoveryEvent;
+  bool m_isDiscoveryScheduled;
+  DiscoveryPolicy m_discovery;
+  time::steady_clock::TimePoint m_discoveryScheduledAt;
+  time::steady_clock::TimePoint m_lastOverheardProbe;
+  size_t m_nProbesSent;
+  size_t m_nProbesSuppressed;
 };
 
 } // namespace iot
@@ -0,0 +1,57 @@
+#include "discovery-policy.hpp"
+
+#include <ndn-cxx/util/random.hpp>
+
+#include <algorithm>
+
+namespace ndn {
+namespace iot {
+
+DiscoveryPolicy::DiscoveryPolicy(const DiscoveryOptions& options)
+  : m_options(options)
+  , m_interval(std::max(options.minInterval, time::milliseconds(1)))
+  , m_hasRun(false)
+{
+}
+
+void
+DiscoveryPolicy::reset()
+{
+  m_interval = std::max(m_options.minInterval, time::milliseconds(1));
+  m_hasRun = false;
+}
+
+time::milliseconds
+DiscoveryPolicy::getDelay() const
+{
+  if (m_options.mode == DiscoveryOptions::DISCOVERY_FIXED) {
+    return m_interval;
+  }
+  return time::milliseconds(random::generateWord32() % m_interval.count());
+}
+
+bool
+DiscoveryPolicy::isSuppressed(const time::steady_clock::TimePoint& scheduledAt,
+			      const time::steady_clock::TimePoint& lastOverheardProbe) const
+{
+  return m_options.mode == DiscoveryOptions::DISCOVERY_ADAPTIVE && m_hasRun &&
+	 lastOverheardProbe > scheduledAt;
+}
+
+void
+DiscoveryPolicy::afterRound(bool hasNewNeighbor)
+{
+  m_hasRun = true;
+  if (m_options.mode == DiscoveryOptions::DISCOVERY_FIXED) {
+    return;
+  }
+  if (hasNewNeighbor) {
+    m_interval = std::max(m_options.minInterval, time::milliseconds(1));
+  }
+  else {
+    m_interval = std::min(m_interval * 2, std::max(m_options.maxInterval, m_interval));
+  }
+}
+
+} // namespace iot
+} // namespace ndn
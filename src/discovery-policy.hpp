@@ -0,0 +1,78 @@
+#ifndef NDN_IOT_DISCOVERY_POLICY_HPP
+#define NDN_IOT_DISCOVERY_POLICY_HPP
+
+#include <ndn-cxx/util/time.hpp>
+
+namespace ndn {
+namespace iot {
+
+struct DiscoveryOptions
+{
+  enum Mode {
+    /** @brief a round every minInterval, without jitter, backoff or suppression
+     */
+    DISCOVERY_FIXED,
+    /** @brief a round at a random point of an interval that doubles while rounds bring
+     *         nothing new, suppressed when a neighbor probed since it was scheduled
+     */
+    DISCOVERY_ADAPTIVE
+  };
+
+  Mode mode = DISCOVERY_ADAPTIVE;
+
+  time::milliseconds minInterval = time::seconds(1);
+
+  time::milliseconds maxInterval = time::seconds(256);
+};
+
+/** @brief When a device runs its discovery rounds
+ *
+ *  Kept apart from the DeviceController, so that replay.app can run the rounds of many
+ *  devices on one link in virtual time.  Like SRM request timers, a suppressed round is
+ *  backed off as a round that found nothing new.  The first round after start or reset()
+ *  is never suppressed: the replies to a probe only reach the prober, so a device that
+ *  never probes never learns the neighbors that stay silent as well.
+ */
+class DiscoveryPolicy
+{
+public:
+  explicit
+  DiscoveryPolicy(const DiscoveryOptions& options = DiscoveryOptions());
+
+  /** @brief restart from the minimal interval with a round that is not suppressed, e.g.
+   *         after the trust state changed
+   */
+  void
+  reset();
+
+  /** @return the delay of the next round from the time it is scheduled
+   */
+  time::milliseconds
+  getDelay() const;
+
+  /** @return whether the round scheduled at @p scheduledAt is skipped, given the last
+   *          time a neighbor's probe was overheard
+   */
+  bool
+  isSuppressed(const time::steady_clock::TimePoint& scheduledAt,
+	       const time::steady_clock::TimePoint& lastOverheardProbe) const;
+
+  void
+  afterRound(bool hasNewNeighbor);
+
+  time::milliseconds
+  getInterval() const
+  {
+    return m_interval;
+  }
+
+private:
+  DiscoveryOptions m_options;
+  time::milliseconds m_interval;
+  bool m_hasRun; // a round since reset()
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_DISCOVERY_POLICY_HPP
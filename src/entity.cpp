@@ -1,35 +1,239 @@
 #include "entity.hpp"
 #include "logger.hpp"
+#include "packet-capture.hpp"
+#include "write-behind-pib.hpp"
 #include <ndn-cxx/lp/tags.hpp>
+#include <ndn-cxx/transport/transport.hpp>
+#include <ndn-cxx/util/random.hpp>
 #include <algorithm>
+#include <limits>
+#include <sstream>
 
 namespace ndn {
 namespace iot {
 
+NDN_IOT_LOG_INIT(entity);
+
+// the lifetime of the first attempt comes from the RTT estimator, this bounds the others
 static const time::milliseconds COMMAND_INTEREST_LIFETIME = time::seconds(4);
 
+// how long a handler may take to reply, and how often that is checked
+static const time::seconds REQUEST_LIFETIME = time::seconds(60);
+static const time::seconds REQUEST_SWEEP_INTERVAL = time::seconds(10);
+static const time::seconds RECONNECT_INTERVAL = time::seconds(1);
+static const time::seconds FILE_FLUSH_INTERVAL = time::seconds(1);
+
+// initialized before main, the closest this process gets to its start
+static const time::steady_clock::TimePoint PROCESS_START = time::steady_clock::now();
+
+/** @brief the tag of every reply, shared as tags are never modified once set
+ */
+static const shared_ptr<lp::CachePolicyTag>&
+getNoCacheTag()
+{
+  static const auto tag = [] {
+    lp::CachePolicy policy;
+    policy.setPolicy(lp::CachePolicyType::NO_CACHE);
+    return make_shared<lp::CachePolicyTag>(policy);
+  }();
+  return tag;
+}
+
+static RttEstimatorOptions
+makeRttOptions()
+{
+  RttEstimatorOptions options;
+  options.maxRto = COMMAND_INTEREST_LIFETIME;
+  return options;
+}
+
+unique_ptr<KeyChain>
+makeKeyChain(const EntityOptions& options)
+{
+  Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
+  switch (options.keyChainMode) {
+  case EntityOptions::KEYCHAIN_MEMORY:
+    return make_unique<KeyChain>("pib-memory:", "tpm-memory:");
+  case EntityOptions::KEYCHAIN_WRITE_BEHIND:
+    // the default TPM, which the PIB loaded from SQLite refers to
+    return make_unique<KeyChain>(WriteBehindPib::getScheme() + ":", "");
+  default:
+    return make_unique<KeyChain>();
+  }
+}
+
+static unique_ptr<Face>
+makeFace(const EntityOptions& options, boost::asio::io_service& ioService, KeyChain& keyChain)
+{
+  if (options.makeFace) {
+    return options.makeFace(ioService, keyChain);
+  }
+  return make_unique<Face>(ioService);
+}
+
 Entity::Entity(const Name& name,
-	       bool keepRunning)
-  : m_face(m_ioService)
+	       bool keepRunning,
+	       const EntityOptions& options)
+  : m_keyChainPtr(makeKeyChain(options))
+  , m_keyChain(*m_keyChainPtr)
+  , m_facePtr(makeFace(options, m_ioService, m_keyChain))
+  , m_face(*m_facePtr)
+  , m_aggregator(m_face)
   , m_controller(m_face, m_keyChain)
-  , m_agent(m_face, m_keyChain, m_controller)
+  , m_agent(m_face, m_keyChain, m_controller, m_aggregator)
   , m_storage(m_ioService, 10)
   , m_scheduler(m_ioService)
+  , m_loopMonitor(m_scheduler, options.loopMonitor)
+  , m_dispatcher(m_face, m_keyChain)
   , m_terminationSignalSet(m_ioService)
+  , m_workers(m_ioService, options.nWorkerThreads)
+  , m_rttEstimator(makeRttOptions())
+  , m_responseCache(options.responseCacheSize)
+  , m_nCommandAttempts(std::max<size_t>(options.nCommandAttempts, 1))
+  , m_commandLoss(options.commandLoss)
   , m_name(name)
+  , m_nStartupSteps(0)
+  , m_isReady(false)
+  , m_exitWhenReady(options.exitWhenReady)
+  , m_forwarderState(m_controller)
+  , m_faceManager(m_face, m_controller, m_scheduler, options.faceManager,
+		  [this] (const std::string& uri) { m_forwarderState.suspendFace(uri); })
+  , m_isForwarderLost(false)
 {
-  m_identity = m_keyChain.createIdentity(m_name);
-  
+  // not before the constructors of subclasses defer their own steps
+  m_ioService.post(deferReady());
+
   if (keepRunning) {
     m_terminationSignalSet.add(SIGINT);
     m_terminationSignalSet.add(SIGTERM);
     m_terminationSignalSet.async_wait(bind(&Entity::terminate, this, _1, _2));
   }
 
-  m_handlerMaps.clear();
-  if (!globalPacketFile.is_open()) {
-    globalPacketFile.open("packet.out", std::ios::out | std::ios::binary);
+  m_dispatcher.addStatusDataset("metrics", mgmt::makeAcceptAllAuthorization(),
+				bind(&Entity::listMetrics, this, _1, _2, _3));
+  m_dispatcher.addTopPrefix("/localhost/iot");
+
+  if (!options.capturePath.empty()) {
+    openPacketCapture(options.capturePath, m_name.toUri(), options.captureSegments);
+  }
+  bool isTracing = false;
+  if (!options.tracePath.empty()) {
+    auto path = trace::openTrace(options.tracePath, m_name.toUri());
+    if (path.empty()) {
+      LOG_FAILURE("trace", "cannot open a trace after " << options.tracePath);
+    }
+    else {
+      LOG_INFO("trace onboarding spans to " << path);
+      isTracing = true;
+    }
+  }
+  if (isTracing || isPacketCaptureOpen()) {
+    m_scheduler.scheduleEvent(FILE_FLUSH_INTERVAL, bind(&Entity::flushFiles, this));
+  }
+
+  m_loopMonitor.start();
+  m_scheduler.scheduleEvent(REQUEST_SWEEP_INTERVAL, bind(&Entity::sweepRequests, this));
+}
+
+void
+Entity::run()
+{
+  // the Face gives up on a broken connection, e.g. to a forwarder that restarts
+  while (true) {
+    try {
+      m_face.processEvents();
+      return;
+    }
+    catch (const Transport::Error& e) {
+      LOG_FAILURE("forwarder", "connection lost: " << e.what());
+      onForwarderLost();
+    }
+  }
+}
+
+void
+Entity::onForwarderLost()
+{
+  if (!m_isForwarderLost) {
+    m_isForwarderLost = true;
+    m_forwarderLostAt = time::steady_clock::now();
+  }
+  m_scheduler.cancelEvent(m_reconnectEvent);
+  m_reconnectEvent = m_scheduler.scheduleEvent(RECONNECT_INTERVAL,
+					       bind(&Entity::reconnectForwarder, this));
+}
+
+void
+Entity::reconnectForwarder()
+{
+  // the Face connects again to send the request
+  m_controller.fetch<nfd::ForwarderGeneralStatusDataset>(
+    bind(&Entity::restoreForwarderState, this),
+    bind(&Entity::onForwarderLost, this));
+}
+
+void
+Entity::restoreForwarderState()
+{
+  m_isForwarderLost = false;
+  Metrics::increment(Metrics::FORWARDER_RECONNECTIONS);
+  LOG_INFO("forwarder is back after "
+	   << time::duration_cast<time::milliseconds>(time::steady_clock::now() - m_forwarderLostAt)
+	   << ", replay " << m_topPrefixes.size() + m_filterPrefixes.size() << " prefixes, "
+	   << m_forwarderState.getFaceIds().size() << " faces and "
+	   << m_forwarderState.getNRoutes() << " routes");
+
+  auto context = make_shared<RecoveryContext>();
+  context->startTime = time::steady_clock::now();
+  context->nPending = 1;
+  context->nFailures = 0;
+
+  // the Face forgot its registered prefixes, but kept their Interest filters
+  for (auto& entry : m_topPrefixes) {
+    ++context->nPending;
+    entry.second.registeredPrefix =
+      m_face.registerPrefix(m_names.getName(entry.first),
+			    bind(&Entity::afterRecoveryStep, this, context, false),
+			    bind(&Entity::afterRecoveryStep, this, context, true));
+  }
+  for (auto id : m_filterPrefixes) {
+    ++context->nPending;
+    m_face.registerPrefix(m_names.getName(id),
+			  bind(&Entity::afterRecoveryStep, this, context, false),
+			  bind(&Entity::afterRecoveryStep, this, context, true));
   }
+  m_dispatcher.removeTopPrefix("/localhost/iot");
+  m_dispatcher.addTopPrefix("/localhost/iot");
+
+  ++context->nPending;
+  m_forwarderState.replay([this, context] (size_t nFailures) {
+      context->nFailures += nFailures;
+      afterRecoveryStep(context, false);
+    });
+
+  ++context->nPending;
+  m_agent.restoreTopPrefixes(bind(&Entity::afterRecoveryStep, this, context, false),
+			     bind(&Entity::afterRecoveryStep, this, context, true));
+
+  // every request is issued
+  afterRecoveryStep(context, false);
+}
+
+void
+Entity::afterRecoveryStep(const shared_ptr<RecoveryContext>& context, bool isFailed)
+{
+  if (isFailed) {
+    ++context->nFailures;
+  }
+  if (--context->nPending > 0) {
+    return;
+  }
+
+  auto recovery = time::steady_clock::now() - context->startTime;
+  Metrics::recordTime(Metrics::FORWARDER_RECOVERY_TIME, recovery);
+  LOG_INFO("forwarder state replayed in "
+	   << time::duration_cast<time::milliseconds>(recovery) << ", "
+	   << context->nFailures << " failed");
 }
 
 void
@@ -40,15 +244,15 @@ Entity::terminate(const boost::system::error_code& error, int signalNo)
 
   LOG_BYEBYE(m_name, "WITH " << ::strsignal(signalNo) << " CAUGHT");
 
-  for (const auto& faceId : m_createdFaces) {
+  for (const auto& faceId : m_forwarderState.getFaceIds()) {
     auto params = nfd::ControlParameters();
     m_controller.start<nfd::FaceDestroyCommand>(params.setFaceId(faceId),
 						bind([] {}), bind([] {}));  
   }
 
-  if (globalPacketFile.is_open()) {
-    globalPacketFile.close();
-  }
+  m_loopMonitor.report();
+  closePacketCapture();
+  trace::closeTrace();
   
   m_ioService.poll();
   m_ioService.stop();
@@ -72,23 +276,89 @@ Entity::makeCommand(Name name, const ControlParameters& params,
 void
 Entity::issueCommand(const Interest& command,
 		     const ResponseHandler& handler,
-		     const Verification& verify)
+		     const Verification& verify,
+		     const VerificationFailCallback& onFailure)
 {
+  // the face toward the device was destroyed while idle
+  if (m_forwarderState.restoreFace(command.getName(),
+				   [=] (const std::string& uri, bool isRestored) {
+				     if (isRestored) {
+				       m_faceManager.track(uri);
+				     }
+				     issueCommand(command, handler, verify, onFailure);
+				   })) {
+    return;
+  }
 
-  auto onFailure = [this] (const std::string& reason) {
+  VerificationFailCallback fail = [onFailure] (const std::string& reason) {
     LOG_FAILURE("command", " faile with " << reason);
+    onFailure(reason);
+  };
+
+  expressCommand(command, 1, time::steady_clock::now(),
+		 m_loopMonitor.wrap("Entity::verifyResponse",
+				    bind(&Entity::verifyResponse, this, _1, _2,
+					 verify, fail, handler)),
+		 fail);
+}
+
+Block
+Entity::issueCommand(const Interest& command, boost::asio::yield_context yield,
+		     const Verification& verify)
+{
+  return await<Block>(yield, [&] (const std::function<void(Block)>& complete) {
+      issueCommand(command, complete, verify, bind(complete, Block()));
+    });
+}
+
+void
+Entity::expressCommand(Interest command, size_t attempt,
+		       const time::steady_clock::TimePoint& issuedAt,
+		       const DataCallback& onResponse,
+		       const VerificationFailCallback& onFailure)
+{
+  auto prefix = getCommandPrefix(command);
+  if (attempt > 1) {
+    // same signed name, the fresh nonce tells the forwarders it is not a loop
+    command.refreshNonce();
+    Metrics::increment(Metrics::COMMAND_RETRANSMITTED);
+  }
+  command.setInterestLifetime(m_rttEstimator.getRto(prefix));
+  auto sentAt = time::steady_clock::now();
+
+  auto onTimeout = [=] (const Interest&) {
+    m_rttEstimator.backoff(prefix);
+    if (attempt < m_nCommandAttempts) {
+      return expressCommand(command, attempt + 1, issuedAt, onResponse, onFailure);
+    }
+    Metrics::increment(Metrics::COMMAND_TIMED_OUT);
+    onFailure("timeout after " + std::to_string(attempt) + " attempts");
   };
 
-  LOG_INTEREST_OUT(command);
-  m_face.expressInterest(command,
-			 bind(&Entity::verifyResponse, this, _1, _2,
-			      verify, onFailure, handler),
-			 [this] (const Interest&, const lp::Nack& nack) {
-			   LOG_FAILURE("command", " nack " << nack.getReason());
-			 },
-			 [this] (const Interest&) {
-			   LOG_FAILURE("command", " timeout ");
-			 });     
+  if (m_commandLoss > 0 &&
+      random::generateWord32() < m_commandLoss * std::numeric_limits<uint32_t>::max()) {
+    LOG_DBG("drop " << command.getName());
+    m_scheduler.scheduleEvent(command.getInterestLifetime(), bind(onTimeout, command));
+    return;
+  }
+
+  m_aggregator.expressInterest(command,
+			       [=] (const Interest& interest, const Data& data) {
+				 auto now = time::steady_clock::now();
+				 // Karn's rule: a reply after a retransmission may answer any attempt
+				 if (attempt == 1) {
+				   m_rttEstimator.addMeasurement(prefix, now - sentAt);
+				   Metrics::recordTime(Metrics::COMMAND_RTT, now - sentAt);
+				 }
+				 Metrics::recordTime(Metrics::COMMAND_TIME, now - issuedAt);
+				 onResponse(interest, data);
+			       },
+			       [onFailure] (const Interest&, const lp::Nack& nack) {
+				 std::ostringstream os;
+				 os << "nack " << nack.getReason();
+				 onFailure(os.str());
+			       },
+			       onTimeout);
 }
 
 void
@@ -96,153 +366,374 @@ Entity::registerCommandHandler(const Name& prefix, const Name& subPrefix,
 			       const CommandHandler& handler,
 			       SecurityOptions options)
 {
-  InterestCallback onInterest = bind(&Entity::authorizeRequester, this, _2,
-				     handler, options);
   auto name = Name(prefix).append(subPrefix);
+  auto registration = make_shared<CommandRegistration>();
+  registration->handler = handler;
+  registration->options = options;
+  m_registrations[m_names.intern(name)] = registration;
 
-  if (!m_handlerMaps[prefix]) {
-    m_handlerMaps[prefix] = true;
+  // small enough for the buffer of the function, so dispatching never allocates
+  auto raw = registration.get();
+  auto onInterest = [this, raw] (const Interest& interest) { authorizeRequester(interest, *raw); };
+  if (!m_commands.insert(name, prefix.size(), onInterest)) {
+    return;
+  }
+
+  auto& topPrefix = m_topPrefixes[m_names.intern(prefix)];
+  if (topPrefix.nHandlers++ > 0) {
+    return;
+  }
+
+  std::function<void()> registered = [] {};
+  if (!m_isReady) {
+    registered = deferReady();
+  }
+  // a prefix that fails to register is a step done, or the entity would never be ready
+  topPrefix.registeredPrefix =
     m_face.registerPrefix(prefix,
-			  bind([name] {}),
-			  bind([name] { LOG_FAILURE("command", "fail to register " << name); }));
+			  bind(registered),
+			  bind([name, registered] {
+			      LOG_FAILURE("command", "fail to register " << name);
+			      registered();
+			    }));
+  topPrefix.interestFilter =
+    m_face.setInterestFilter(prefix,
+			     [this] (const InterestFilter& filter, const Interest& interest) {
+			       if (!m_commands.dispatch(filter.getPrefix().size(), interest)) {
+				 LOG_DBG("no command handler of " << interest.getName());
+			       }
+			     });
+}
+
+void
+Entity::unregisterCommandHandler(const Name& prefix, const Name& subPrefix)
+{
+  auto name = Name(prefix).append(subPrefix);
+  if (!m_commands.erase(name)) {
+    return;
+  }
+  // requests in progress keep their registration
+  m_registrations.erase(m_names.find(name));
+
+  auto it = m_topPrefixes.find(m_names.find(prefix));
+  if (it == m_topPrefixes.end() || --it->second.nHandlers > 0) {
+    return;
   }
 
-  m_face.setInterestFilter(name, onInterest);
+  m_face.unsetInterestFilter(it->second.interestFilter);
+  m_face.unregisterPrefix(it->second.registeredPrefix,
+			  bind([] {}),
+			  bind([prefix] { LOG_FAILURE("command", "fail to unregister " << prefix); }));
+  m_topPrefixes.erase(it);
 }
 
 void
-Entity::authorizeRequester(const Interest& interest,
-			   const CommandHandler& handler,
-			   SecurityOptions options)
+Entity::authorizeRequester(const Interest& interest, const CommandRegistration& registration)
 {
+  LoopMonitor::Scope scope(m_loopMonitor, "Entity::authorizeRequester");
+  capturePacket(interest, capture::INCOMING);
   LOG_INTEREST_IN(interest);
 
+  if (BroadcastAgent::isResponderExcluded(interest, m_name)) {
+    LOG_DBG("already heard by the collector, keep silent");
+    return;
+  }
+
+  shared_ptr<const Data> reply;
+  switch (m_responseCache.lookup(interest.getName(), reply)) {
+  case ResponseCache::HIT:
+    LOG_DBG("retransmitted command, reply again");
+    m_face.put(*reply);
+    capturePacket(*reply, capture::OUTGOING);
+    LOG_DATA_OUT(*reply);
+    return;
+  case ResponseCache::PENDING:
+    LOG_DBG("retransmitted command still in progress, drop");
+    return;
+  case ResponseCache::MISS:
+    break;
+  }
+
+  const auto& options = registration.options;
+  Metrics::incrementCommand(Metrics::COMMAND_RECEIVED, options.getVerificationOption());
+
+  // assignments into a recycled context reuse the storage of the previous request
+  auto request = m_requests.acquire();
+  auto context = m_requests.get(request);
+  context->interest = interest;
+  context->registration = registration.shared_from_this();
+  context->options = options;
+  context->expiry = time::steady_clock::now() + REQUEST_LIFETIME;
+
   if (options.getVerificationOption() == SecurityOptions::NOT_SET) {
-    return afterAuthorization(interest, handler, options);
+    return afterAuthorization(request);
   }
 
   if (options.getVerificationOption() & SecurityOptions::HMAC) {
-    if (hmac::verifyInterest(interest, options.getPinCode())) {
-      options.setVerificationType(SecurityOptions::HMAC);
-      return afterAuthorization(interest, handler, options);
-    }
+    context->isBusy = true;
+    return m_workers.post(getRequesterKey(interest),
+			  [context] {
+			    context->isVerified = hmac::verifyInterest(context->interest,
+								       context->options.getPinCode());
+			  },
+			  [this, request] {
+			    auto context = m_requests.get(request);
+			    context->isBusy = false;
+			    if (context->isVerified) {
+			      context->options.setVerificationType(SecurityOptions::HMAC);
+			      return afterAuthorization(request);
+			    }
+			    verifyInterestByKey(request);
+			  });
   }
 
-  verifyInterestByKey(interest, options,
-		      bind(&Entity::afterAuthorization, this, interest, handler, _1));
+  verifyInterestByKey(request);
 }
 
 void
-Entity::verifyInterestByKey(const Interest& interest,
-			    SecurityOptions options,
-			    const AuthorizationCallback& cbAfterAuthorization)
+Entity::verifyInterestByKey(RequestHandle request)
 {
+  auto context = m_requests.get(request);
+
   Name klName;
-  if (!getKeyLocatorName(interest, klName)) {
+  if (!getKeyLocatorName(context->interest, klName)) {
     LOG_FAILURE("command", "can not get kl name " << klName);
-    return;
+    return failRequest(request);
   }
 
   if (m_certificates.empty()) {
     LOG_DBG("no trust anchor to verify this request");
-    return;    
+    return failRequest(request);
   }
 
-  if (m_certificates.find(klName) != m_certificates.end()) {
-    options.setVerificationType(SecurityOptions::IDENTITY);
-    cbAfterAuthorization(options);
-    return;
+  if (findCertificate(klName) != nullptr) {
+    context->options.setVerificationType(SecurityOptions::IDENTITY);
+    return afterAuthorization(request);
   }
 
-  DataCallback onData = bind(&Entity::verifyDataByKey, this, _2, options, cbAfterAuthorization);
-  NackCallback onNack = [klName] (const Interest&, const lp::Nack& nack) {
+  DataCallback onData = m_loopMonitor.wrap("Entity::verifyDataByKey",
+					    [this, request] (const Interest&, const Data& data) {
+					      verifyDataByKey(data, request);
+					    });
+  NackCallback onNack = [this, klName, request] (const Interest&, const lp::Nack& nack) {
     LOG_FAILURE("verify by key", "Nack (" << nack.getReason() << ") on fetching cert " << klName);
+    failRequest(request);
   };
-  TimeoutCallback onTimeout = [klName] (const Interest&) {
+  TimeoutCallback onTimeout = [this, klName, request] (const Interest&) {
     LOG_FAILURE("verify by key", "Timeout on fetching cert " << klName);
+    failRequest(request);
   };
   
-  m_face.expressInterest(Interest(klName), onData, onNack, onTimeout);
+  m_aggregator.expressInterest(Interest(klName), onData, onNack, onTimeout);
 }
 
 void
-Entity::verifyDataByKey(const Data& data,
-			SecurityOptions options,
-			const AuthorizationCallback& cbAfterAuthorization)
+Entity::verifyDataByKey(const Data& data, RequestHandle request)
 {
-  LOG_DATA_IN(data);
+  auto context = m_requests.get(request);
+  if (context == nullptr) {
+    LOG_DBG("certificate of an expired request");
+    return;
+  }
 
   Name klName;
   if (!getKeyLocatorName(data, klName)) {
     LOG_FAILURE("command", "can not get kl name " << klName);
-    return;
+    return failRequest(request);
   }
 
   if (m_certificates.empty()) {
     LOG_DBG("no trust anchor to verify this request");
-    return;    
+    return failRequest(request);
   }
 
-  if (m_certificates.find(klName) != m_certificates.end()) {
-    options.setVerificationType(SecurityOptions::IDENTITY);
-    cbAfterAuthorization(options);
-    return;
+  if (findCertificate(klName) != nullptr) {
+    context->options.setVerificationType(SecurityOptions::IDENTITY);
+    return afterAuthorization(request);
   }
 
-  DataCallback onData = bind(&Entity::verifyDataByKey, this, _2, options, cbAfterAuthorization);
-  NackCallback onNack = [klName] (const Interest&, const lp::Nack& nack) {
+  DataCallback onData = m_loopMonitor.wrap("Entity::verifyDataByKey",
+					    [this, request] (const Interest&, const Data& data) {
+					      verifyDataByKey(data, request);
+					    });
+  NackCallback onNack = [this, klName, request] (const Interest&, const lp::Nack& nack) {
     LOG_FAILURE("verify by key", "Nack (" << nack.getReason() << ") on fetching cert " << klName);
+    failRequest(request);
   };
-  TimeoutCallback onTimeout = [klName] (const Interest&) {
+  TimeoutCallback onTimeout = [this, klName, request] (const Interest&) {
     LOG_FAILURE("verify by key", "Timeout on fetching cert " << klName);
+    failRequest(request);
   };
   
-  m_face.expressInterest(Interest(klName), onData, onNack, onTimeout);
+  m_aggregator.expressInterest(Interest(klName), onData, onNack, onTimeout);
 }
 
 void
-Entity::afterAuthorization(const Interest& interest,
-			   const CommandHandler& handler,
-			   SecurityOptions options)
+Entity::afterAuthorization(RequestHandle request)
 {
+  auto context = m_requests.get(request);
+  if (!m_responseCache.markPending(context->interest.getName(), context->expiry)) {
+    LOG_DBG("retransmitted command authorized twice, drop");
+    m_requests.release(request);
+    return;
+  }
+  Metrics::incrementCommand(Metrics::COMMAND_VERIFIED, context->options.getVerificationType());
+
+  // the handler may reply at once, which releases the context, or unregister itself,
+  // so it gets copies of what it must not see cleared under it
+  auto registration = context->registration;
+  auto options = context->options;
   try {
-    auto params = ControlParameters::fromCommandInterest(interest);
-    handler(params, bind(&Entity::replyRequest, this, interest, options, _1), options);
+    Metrics::ScopedTimer timer(Metrics::HANDLER_TIME);
+    auto params = ControlParameters::fromCommandInterest(context->interest);
+    registration->handler(params,
+			  [this, request] (const Block& content) { replyRequest(request, content); },
+			  options);
   }
   catch (const ControlParameters::Error& e) {
     LOG_FAILURE("command", "can not parse the parameters: " << e.what());
+    m_responseCache.erase(context->interest.getName());
+    m_requests.release(request);
   } 
 }
 
 void
-Entity::replyRequest(const Interest& interest,
-		     SecurityOptions options,
-		     const Block& content)
+Entity::failRequest(RequestHandle request)
+{
+  auto context = m_requests.get(request);
+  if (context == nullptr) {
+    return;
+  }
+  Metrics::incrementCommand(Metrics::COMMAND_FAILED, context->options.getVerificationOption());
+  m_responseCache.erase(context->interest.getName());
+  m_requests.release(request);
+}
+
+std::function<void()>
+Entity::deferReady()
+{
+  ++m_nStartupSteps;
+  auto isDone = make_shared<bool>(false);
+  return [this, isDone] {
+    if (*isDone) {
+      return;
+    }
+    *isDone = true;
+    if (--m_nStartupSteps == 0) {
+      afterReady();
+    }
+  };
+}
+
+void
+Entity::afterReady()
+{
+  m_isReady = true;
+  auto startup = time::steady_clock::now() - PROCESS_START;
+  Metrics::recordTime(Metrics::STARTUP_TIME, startup);
+  LOG_INFO("ready " << time::duration_cast<time::milliseconds>(startup) << " after start");
+
+  if (m_exitWhenReady) {
+    std::cout << "startup: "
+	      << time::duration_cast<time::microseconds>(startup).count() << " us" << std::endl;
+    m_ioService.stop();
+    return;
+  }
+
+  getIdentity();
+}
+
+void
+Entity::sweepRequests()
 {
-  auto data = make_shared<Data>(Name(interest.getName()).appendVersion());
+  auto now = time::steady_clock::now();
+  auto nExpired = m_requests.releaseIf([this, now] (const RequestContext& context) {
+      if (context.isBusy || context.expiry >= now) {
+	return false;
+      }
+      m_responseCache.erase(context.interest.getName());
+      return true;
+    });
+  if (nExpired > 0) {
+    LOG_DBG(nExpired << " requests expired without reply");
+  }
+
+  m_scheduler.scheduleEvent(REQUEST_SWEEP_INTERVAL, bind(&Entity::sweepRequests, this));
+}
+
+void
+Entity::flushFiles()
+{
+  flushPacketCapture();
+  trace::flushTrace();
+  m_scheduler.scheduleEvent(FILE_FLUSH_INTERVAL, bind(&Entity::flushFiles, this));
+}
+
+void
+Entity::replyRequest(RequestHandle request, const Block& content)
+{
+  auto context = m_requests.get(request);
+  if (context == nullptr) {
+    LOG_FAILURE("command", "reply to an expired request");
+    return;
+  }
+
+  context->reply = make_shared<Data>(Name(context->interest.getName()).appendVersion());
   try {
-    data->setContent(content);
+    context->reply->setContent(content);
   }
   catch (const tlv::Error& e) {
     LOG_FAILURE("command", "can not set content for response: " << e.what());
   }
 
+  const auto& options = context->options;
   if (options.getSigningOption() & SecurityOptions::HMAC) {
-    hmac::signData(*data, options.getPinCode());
+    context->isBusy = true;
+    return m_workers.post(getRequesterKey(context->interest),
+			  [context] {
+			    hmac::signData(*context->reply, context->options.getPinCode());
+			  },
+			  [this, request] { putReply(request); });
   }
   else if (options.getSigningOption() & SecurityOptions::IDENTITY) {
-    m_keyChain.sign(*data);
+    Metrics::ScopedTimer timer(Metrics::SIGNATURE_TIME);
+    m_keyChain.sign(*context->reply);
   }
   else {
-    m_keyChain.sign(*data);
+    Metrics::ScopedTimer timer(Metrics::SIGNATURE_TIME);
+    m_keyChain.sign(*context->reply);
   }
 
-  lp::CachePolicy policy;
-  policy.setPolicy(lp::CachePolicyType::NO_CACHE);
-  data->setTag(make_shared<lp::CachePolicyTag>(policy));
+  putReply(request);
+}
 
+void
+Entity::putReply(RequestHandle request)
+{
+  auto context = m_requests.get(request);
+  auto& data = context->reply;
+  data->setTag(getNoCacheTag());
+
+  m_responseCache.insert(context->interest.getName(), data);
   m_face.put(*data);
+  capturePacket(*data, capture::OUTGOING);
   LOG_DATA_OUT(*data);
+  m_requests.release(request);
+}
+
+Name
+Entity::getCommandPrefix(const Interest& interest)
+{
+  // parameters, timestamp, nonce, signature info and value
+  const ssize_t N_COMMAND_COMPONENTS = command_interest::MIN_SIZE + 1;
+  return interest.getName().getPrefix(-N_COMMAND_COMPONENTS);
+}
+
+size_t
+Entity::getRequesterKey(const Interest& interest)
+{
+  // the timestamp and nonce differ per command, so they must not be part of the key
+  return std::hash<Name>()(getCommandPrefix(interest));
 }
 
 void
@@ -252,15 +743,30 @@ Entity::broadcast(const Interest& interest,
 		  const VerificationFailCallback& onFailure)
 {
   m_agent.broadcast(interest,
-		    bind(&Entity::verifyResponse, this, _1, _2, verify, onFailure, handler),
-		    [] (const Interest&, const lp::Nack& nack) {
+		    m_loopMonitor.wrap("Entity::verifyResponse",
+				       bind(&Entity::verifyResponse, this, _1, _2,
+					    verify, onFailure, handler)),
+		    [onFailure] (const Interest&, const lp::Nack& nack) {
 		      LOG_FAILURE("broadcast", "NACK: " << nack.getReason());
+		      std::ostringstream os;
+		      os << "NACK " << nack.getReason();
+		      onFailure(os.str());
 		    },
-		    [] (const Interest&) {
+		    [onFailure] (const Interest&) {
 		      LOG_FAILURE("broadcast", "TIMEOUT");
+		      onFailure("TIMEOUT");
 		    });
 }
 
+Block
+Entity::broadcast(const Interest& interest, boost::asio::yield_context yield,
+		  const Verification& verify)
+{
+  return await<Block>(yield, [&] (const std::function<void(Block)>& complete) {
+      broadcast(interest, complete, verify, bind(complete, Block()));
+    });
+}
+
 void
 Entity::registerPrefixOnFace(const Name& name, uint64_t faceId,
 			     const CommandSuccessCallback& onSuccess,
@@ -273,9 +779,38 @@ Entity::registerPrefixOnFace(const Name& name, uint64_t faceId,
     .setCost(0)
     .setExpirationPeriod(time::milliseconds::max());
 
+  m_forwarderState.addRoute(name, faceId);
   m_controller.start<nfd::RibRegisterCommand>(ribParameters, onSuccess, onFailure);  
 }
 
+nfd::ControlResponse
+Entity::registerPrefixOnFace(const Name& name, uint64_t faceId,
+			     boost::asio::yield_context yield)
+{
+  nfd::ControlParameters ribParameters;
+  ribParameters
+    .setName(name)
+    .setFaceId(faceId)
+    .setCost(0)
+    .setExpirationPeriod(time::milliseconds::max());
+
+  m_forwarderState.addRoute(name, faceId);
+  return startNfdCommand<nfd::RibRegisterCommand>(ribParameters, yield);
+}
+
+bool
+Entity::canonizeUri(FaceUri& uri, time::nanoseconds timeout, boost::asio::yield_context yield)
+{
+  auto canonical = await<FaceUri>(yield, [&] (const std::function<void(FaceUri)>& complete) {
+      uri.canonize(complete, bind(complete, FaceUri()), m_ioService, timeout);
+    });
+  if (canonical.getScheme().empty()) {
+    return false;
+  }
+  uri = canonical;
+  return true;
+}
+
 void
 Entity::verifyResponse(const Interest& interest,
 		       const Data& data,
@@ -283,7 +818,6 @@ Entity::verifyResponse(const Interest& interest,
 		       const VerificationFailCallback& onFailure,
 		       const ResponseHandler& handler)
 {
-  LOG_DATA_IN(data);
   if (!interest.matchesData(data)) {
     return onFailure("interest and data do not match");
   }
@@ -304,14 +838,35 @@ Entity::verifyResponse(const Interest& interest,
 }
 
 
+security::Identity&
+Entity::getIdentity()
+{
+  if (m_identity) {
+    return m_identity;
+  }
+
+  Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
+  try {
+    m_identity = m_keyChain.getPib().getIdentity(m_name);
+    m_identity.getDefaultKey();
+  }
+  catch (const security::Pib::Error&) {
+    createKey();
+    m_identity = m_keyChain.getPib().getIdentity(m_name);
+  }
+  return m_identity;
+}
+
 security::Key
 Entity::getDefaultKey()
 {
+  auto& identity = getIdentity();
+  Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
   try {
-    return m_identity.getDefaultKey();
+    return identity.getDefaultKey();
   }
   catch (const security::Pib::Error&) {
-    return m_keyChain.createKey(m_identity);
+    return createKey();
   }
 }
 
@@ -319,14 +874,27 @@ security::v2::Certificate
 Entity::getDefaultCertificate()
 {
   auto key = getDefaultKey();
+  Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
   try {
     return key.getDefaultCertificate();
   }
   catch (const security::Pib::Error&) {
-    return m_keyChain.createKey(m_identity).getDefaultCertificate();
+    return createKey().getDefaultCertificate();
   }  
 }
 
+security::Key
+Entity::createKey()
+{
+  Metrics::ScopedTimer timer(Metrics::KEY_GENERATION_TIME);
+  try {
+    return m_keyChain.createKey(m_keyChain.getPib().getIdentity(m_name));
+  }
+  catch (const security::Pib::Error&) {
+    return m_keyChain.createIdentity(m_name).getDefaultKey();
+  }
+}
+
 void
 Entity::publishCertificate(const Name& keyName, const security::v2::Certificate& certificate)
 {
@@ -341,13 +909,22 @@ Entity::publishCertificate(const Name& keyName, const security::v2::Certificate&
     std::cout << e.what() << std::endl;
   }
 
-  m_certificates[certificate.getName()] = certificate;
+  storeCertificate(certificate);
   LOG_DBG("certificate " << keyName << " is published");
 	   
-  m_face.setInterestFilter(keyName,
-			   bind(&Entity::fetchCertificate, this, _2),
-			   bind([keyName] { LOG_DBG("listen to requests to this certificate"); }),
-			   bind([keyName] { LOG_FAILURE("cert", "fail to listen" << keyName); }));
+  listen(keyName, bind(&Entity::fetchCertificate, this, _2));
+}
+
+void
+Entity::listen(const Name& prefix, const InterestCallback& onInterest)
+{
+  // publishCertificate() listens to the same key name again for every certificate
+  if (!m_filterPrefixes.insert(m_names.intern(prefix)).second) {
+    return;
+  }
+  m_face.setInterestFilter(prefix, onInterest,
+			   bind([prefix] { LOG_DBG("listen to " << prefix); }),
+			   bind([prefix] { LOG_FAILURE("listen", "fail to register " << prefix); }));
 }
 
 void
@@ -368,14 +945,45 @@ Entity::fetchCertificate(const Interest& interest)
 
   LOG_STEP(3.2, "Fetch and supply certificate: " << interest.getName());
 
+  capturePacket(interest, capture::INCOMING);
   LOG_INTEREST_IN(interest);
-  for (const auto& entry : m_certificates) {
-    if (interest.matchesData(entry.second)) {
-      m_face.put(entry.second);
-      LOG_DATA_OUT(entry.second);
-      break;
-    }
+  auto wire = findCertificate(interest.getName());
+  if (wire == nullptr) {
+    LOG_DBG("no certificate of " << interest.getName());
+    return;
+  }
+
+  Data certificate(*wire);
+  if (interest.matchesData(certificate)) {
+    m_face.put(certificate);
+    capturePacket(certificate, capture::OUTGOING);
+    LOG_DATA_OUT(certificate);
+  }
+}
+
+void
+Entity::storeCertificate(const security::v2::Certificate& certificate)
+{
+  m_certificates[m_names.intern(certificate.getKeyName())] = certificate.wireEncode();
+}
+
+const Block*
+Entity::findCertificate(const Name& name) const
+{
+  auto id = m_names.find(security::v2::Certificate::isValidName(name) ?
+			 security::v2::extractKeyNameFromCertName(name) : name);
+  auto it = m_certificates.find(id);
+  return it == m_certificates.end() ? nullptr : &it->second;
+}
+
+void
+Entity::listMetrics(const Name& topPrefix, const Interest& interest,
+		    mgmt::StatusDatasetContext& context)
+{
+  for (const auto& block : Metrics::encode(Metrics::snapshot())) {
+    context.append(block);
   }
+  context.end();
 }
 
 bool
@@ -5,34 +5,137 @@
 #include "broadcast-agent.hpp"
 #include "security-options.hpp"
 #include "hmac-helper.hpp"
+#include "loop-monitor.hpp"
+#include "worker-pool.hpp"
+#include "rtt-estimator.hpp"
+#include "response-cache.hpp"
+#include "forwarder-state.hpp"
+#include "face-manager.hpp"
+#include "discovery-policy.hpp"
+#include "command-dispatcher.hpp"
+#include "object-pool.hpp"
+#include "name-table.hpp"
+#include "await.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 #include <ndn-cxx/util/scheduler.hpp>
 #include <ndn-cxx/mgmt/dispatcher.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <ndn-cxx/mgmt/control-response.hpp>
+#include <ndn-cxx/mgmt/nfd/control-command.hpp>
+#include <ndn-cxx/net/face-uri.hpp>
 #include <ndn-cxx/security/command-interest-signer.hpp>
 #include <ndn-cxx/security/pib/identity.hpp>
 #include <ndn-cxx/ims/in-memory-storage-fifo.hpp>
 #include <ndn-cxx/security/v2/validator.hpp>
 
 #include <fstream>
+#include <unordered_set>
 
 namespace ndn {
 namespace iot {
 
 using mgmt::ControlResponse;
 
+/** @brief Runtime options of an Entity
+ */
+struct EntityOptions
+{
+  typedef boost::function<unique_ptr<Face>(boost::asio::io_service& ioService,
+					   KeyChain& keyChain)> FaceFactory;
+
+  enum KeyChainMode {
+    /** @brief the PIB and TPM of the user, written through on every update
+     */
+    KEYCHAIN_DEFAULT,
+    /** @brief a PIB and TPM in memory, discarded on exit, for benchmarks and tests
+     */
+    KEYCHAIN_MEMORY,
+    /** @brief the SQLite PIB of the user served from memory, see WriteBehindPib
+     */
+    KEYCHAIN_WRITE_BEHIND
+  };
+
+  /** @brief make the Face toward the forwarder, e.g. an in-process face for replays;
+   *         a Face on the default transport if not set
+   */
+  FaceFactory makeFace;
+
+  KeyChainMode keyChainMode = KEYCHAIN_DEFAULT;
+
+  /** @brief stop as soon as the entity is ready, to benchmark the startup
+   */
+  bool exitWhenReady = false;
+
+  /** @brief where to capture the packets of this entity, nothing is captured if empty
+   */
+  std::string capturePath;
+
+  /** @brief capture segments kept on disk, the oldest removed first; all kept if zero
+   */
+  size_t captureSegments = 8;
+
+  /** @brief where to write the onboarding spans of this entity, nothing is traced if empty
+   */
+  std::string tracePath;
+
+  LoopMonitorOptions loopMonitor;
+
+  /** @brief threads to offload HMAC verification and signing of commands to; everything
+   *         runs on the thread of the Face if zero
+   *  @note decoding, dispatch and the handlers stay on the thread of the Face, so more
+   *        threads than one shorten the HMAC part of a command but do not scale throughput
+   */
+  size_t nWorkerThreads = 0;
+
+  /** @brief attempts of a command, including the first, before it fails with a timeout
+   */
+  size_t nCommandAttempts = 4;
+
+  /** @brief fraction of command Interests dropped instead of sent, to measure the
+   *         retransmission of commands under loss
+   */
+  double commandLoss = 0.0;
+
+  /** @brief replies kept to answer retransmitted commands
+   */
+  size_t responseCacheSize = 256;
+
+  /** @brief faces toward devices destroyed once idle, and created again when addressed
+   */
+  FaceManagerOptions faceManager;
+
+  /** @brief when a device runs its discovery rounds
+   */
+  DiscoveryOptions discovery;
+};
+
+/** @brief make the KeyChain selected by the keyChainMode of @p options
+ */
+unique_ptr<KeyChain>
+makeKeyChain(const EntityOptions& options);
+
 class Entity : public security::CommandInterestPreparer
 {
 public:
   Entity(const Name& name,
-	 bool keepRunning = false);
+	 bool keepRunning = false,
+	 const EntityOptions& options = EntityOptions());
+
+  virtual
+  ~Entity() = default;
 
 public:
+  /** @brief process events until terminated, reconnecting to a forwarder that restarts
+   */
   virtual void
-  run()
+  run();
+
+  boost::asio::io_service&
+  getIoService()
   {
-    m_face.processEvents();
+    return m_ioService;
   }
 
   void
@@ -48,7 +151,7 @@ public: // command
   typedef boost::function<void(const Block& block)> ReplyWithContent;
   typedef boost::function<void(const ControlParameters& parameters,
 			       const ReplyWithContent& done,
-			       SecurityOptions options)> CommandHandler;
+			       const SecurityOptions& options)> CommandHandler;
   typedef boost::function<bool(const Interest& interset)> Authorization;
   typedef boost::function<bool(const Data& data)> Verification;
   typedef boost::function<void(const std::string& reason)> VerificationFailCallback;
@@ -59,6 +162,7 @@ public: // command
   static InterestSigner
   makeDefaultInterestSigner() {
     return [] (Interest& interest, KeyChain& keyChain) {
+      Metrics::ScopedTimer timer(Metrics::SIGNATURE_TIME);
       keyChain.sign(interest);
     };
   }
@@ -66,6 +170,7 @@ public: // command
   static DataSigner
   makeDefaultDataSigner() {
     return [] (Data& data, KeyChain& keyChain) {
+      Metrics::ScopedTimer timer(Metrics::SIGNATURE_TIME);
       keyChain.sign(data);
     };
   }
@@ -75,6 +180,9 @@ public: // command
 			 const CommandHandler& handler,
 			 SecurityOptions options = SecurityOptions());
 
+  void
+  unregisterCommandHandler(const Name& prefix, const Name& subPrefix);
+
   Interest
   makeCommand(Name name, const ControlParameters& params,
 	      const InterestSigner& sign = Entity::makeDefaultInterestSigner());
@@ -82,7 +190,8 @@ public: // command
   void
   issueCommand(const Interest& command,
 	       const ResponseHandler& handler,
-	       const Verification& verify = bind([] { return true; }));
+	       const Verification& verify = bind([] { return true; }),
+	       const VerificationFailCallback& onFailure = [] (const std::string& reason) {});
 
 public: // operation
   typedef boost::function<void(const nfd::ControlParameters& params)> CommandSuccessCallback;
@@ -99,40 +208,176 @@ public: // operation
 		       const CommandSuccessCallback& onSuccess,
 		       const CommandFailCallback& onFailure);
 
+public: // awaitable operation, in a coroutine spawned on getIoService()
+  /** @return the content of the verified response, an invalid Block on failure
+   */
+  Block
+  issueCommand(const Interest& command, boost::asio::yield_context yield,
+	       const Verification& verify = bind([] { return true; }));
+
+  /** @return the content of the first verified reply, an invalid Block on failure
+   */
+  Block
+  broadcast(const Interest& interest, boost::asio::yield_context yield,
+	    const Verification& verify = bind([] { return true; }));
+
+  /** @return the response of NFD, whose body on success is the ControlParameters
+   */
+  template<typename Command>
+  nfd::ControlResponse
+  startNfdCommand(const nfd::ControlParameters& params, boost::asio::yield_context yield)
+  {
+    typedef std::function<void(nfd::ControlResponse)> Complete;
+    return await<nfd::ControlResponse>(yield, [&] (const Complete& complete) {
+	m_controller.start<Command>(params,
+				    [complete] (const nfd::ControlParameters& body) {
+				      complete(nfd::ControlResponse(200, "OK")
+					       .setBody(body.wireEncode()));
+				    },
+				    complete);
+      });
+  }
+
+  nfd::ControlResponse
+  registerPrefixOnFace(const Name& name, uint64_t faceId, boost::asio::yield_context yield);
+
+  /** @brief canonize @p uri in place
+   *  @return false if it cannot be canonized within @p timeout
+   */
+  bool
+  canonizeUri(FaceUri& uri, time::nanoseconds timeout, boost::asio::yield_context yield);
+
+  /** @brief the identity of the entity, loaded or created on first use
+   */
+  security::Identity&
+  getIdentity();
+
   security::Key
   getDefaultKey();
 
   security::v2::Certificate
   getDefaultCertificate();
 
+  /** @brief generate a key of the identity, which is created if needed
+   */
+  security::Key
+  createKey();
+
+  /** @brief hold off readiness until the returned callback is called
+   *
+   *  Steps deferred in the constructors run concurrently; the entity is ready once the
+   *  last one is done, see afterReady().  Command handlers registered before then defer
+   *  readiness until their prefix is registered.
+   */
+  std::function<void()>
+  deferReady();
+
   void
   publishCertificate(const Name& keyName, const security::v2::Certificate& certificate);
 
   void
   fetchCertificate(const Interest& interest);
 
+  /** @brief set an Interest filter and register its prefix, again after the forwarder
+   *         restarts
+   *  @note a prefix already listened to keeps its filter and callback
+   */
+  void
+  listen(const Name& prefix, const InterestCallback& onInterest);
+
+  /** @brief keep @p certificate as the one of its key, to verify and to supply
+   */
+  void
+  storeCertificate(const security::v2::Certificate& certificate);
+
+  /** @return the stored certificate of the key or certificate @p name, or nullptr
+   */
+  const Block*
+  findCertificate(const Name& name) const;
+
 private:
-  typedef boost::function<void(SecurityOptions options)> AuthorizationCallback;
-  
+  /** @brief a command handler with the security options of its prefix
+   */
+  struct CommandRegistration : enable_shared_from_this<CommandRegistration>
+  {
+    CommandHandler handler;
+    SecurityOptions options;
+  };
+
+  /** @brief an incoming command from its arrival to its reply, recycled through m_requests
+   *         so that its Interest name and PIN reuse their storage
+   */
+  struct RequestContext
+  {
+    RequestContext()
+      : isVerified(false)
+      , isBusy(false)
+    {
+    }
+
+    void
+    clear()
+    {
+      registration.reset();
+      reply.reset();
+      isVerified = false;
+      isBusy = false;
+    }
+
+    Interest interest;
+    shared_ptr<const CommandRegistration> registration;
+    SecurityOptions options;
+    shared_ptr<Data> reply;
+    time::steady_clock::TimePoint expiry;
+    bool isVerified;
+    bool isBusy; // in the hands of a worker thread, which may read it
+  };
+
+  typedef ObjectPool<RequestContext>::Handle RequestHandle;
+
+  void
+  authorizeRequester(const Interest& interest, const CommandRegistration& registration);
+
+  void
+  verifyInterestByKey(RequestHandle request);
+
+  void
+  verifyDataByKey(const Data& data, RequestHandle request);
+
+  void
+  afterAuthorization(RequestHandle request);
+
+  void
+  failRequest(RequestHandle request);
+
+  /** @brief release the requests whose handler never replied
+   */
+  void
+  sweepRequests();
+
+  /** @brief write what the capture and the trace buffered, so an idle entity does not
+   *         hold it back
+   */
+  void
+  flushFiles();
+
+  /** @brief record the startup time, then load the identity off the startup path
+   */
   void
-  authorizeRequester(const Interest& interest,
-		     const CommandHandler& handler,
-		     SecurityOptions options);
+  afterReady();
 
+  /** @brief try to reach the forwarder again in a while
+   */
   void
-  verifyInterestByKey(const Interest& interset,
-		      SecurityOptions options,
-		      const AuthorizationCallback& cbAfterAuthorization);
+  onForwarderLost();
 
   void
-  verifyDataByKey(const Data& data,
-		  SecurityOptions options,
-		  const AuthorizationCallback& cbAfterAuthorization);
+  reconnectForwarder();
 
+  /** @brief replay the registrations, faces and routes the forwarder lost, all at once
+   */
   void
-  afterAuthorization(const Interest& interest,
-		     const CommandHandler& handler,
-		     SecurityOptions options);
+  restoreForwarderState();
 
   void
   verifyResponse(const Interest& interest,
@@ -141,10 +386,29 @@ private:
 		 const VerificationFailCallback& onFailure,
 		 const ResponseHandler& handler);
 
+  /** @brief express an attempt of a command, and retransmit it after an RTO without reply
+   */
   void
-  replyRequest(const Interest& interest,
-	       SecurityOptions options,
-	       const Block& content);
+  expressCommand(Interest command, size_t attempt,
+		 const time::steady_clock::TimePoint& issuedAt,
+		 const DataCallback& onResponse,
+		 const VerificationFailCallback& onFailure);
+
+  void
+  replyRequest(RequestHandle request, const Block& content);
+
+  void
+  putReply(RequestHandle request);
+
+  /** @brief the name of a command without its parameters and signed Interest components
+   */
+  static Name
+  getCommandPrefix(const Interest& interest);
+
+  /** @brief the strand key of a command, which serializes the work of one requester
+   */
+  static size_t
+  getRequesterKey(const Interest& interest);
   
 public:
   void
@@ -168,22 +432,73 @@ private:
 
   bool
   getKeyLocatorName(const SignatureInfo& si, Name& name);
+
+  void
+  listMetrics(const Name& topPrefix, const Interest& interest,
+	      mgmt::StatusDatasetContext& context);
+
+private:
+  /** @brief a prefix registered for command handlers, with one Interest filter
+   */
+  struct TopPrefix
+  {
+    const RegisteredPrefixId* registeredPrefix = nullptr;
+    const InterestFilterId* interestFilter = nullptr;
+    size_t nHandlers = 0;
+  };
+
+  /** @brief state of one restoreForwarderState call
+   */
+  struct RecoveryContext
+  {
+    time::steady_clock::TimePoint startTime;
+    size_t nPending;
+    size_t nFailures;
+  };
+
+  void
+  afterRecoveryStep(const shared_ptr<RecoveryContext>& context, bool isFailed);
   
 protected:
   boost::asio::io_service m_ioService;
-  Face m_face;
-  KeyChain m_keyChain;
+  unique_ptr<KeyChain> m_keyChainPtr;
+  KeyChain& m_keyChain;
+  unique_ptr<Face> m_facePtr;
+  Face& m_face;
+  InterestAggregator m_aggregator;
   BroadcastAgent m_agent;
   nfd::Controller m_controller;
   InMemoryStorageFifo m_storage;
   Scheduler m_scheduler;
+  LoopMonitor m_loopMonitor;
+  mgmt::Dispatcher m_dispatcher;
   boost::asio::signal_set m_terminationSignalSet;
+  WorkerPool m_workers;
+  RttEstimator m_rttEstimator;
+  ResponseCache m_responseCache;
+  size_t m_nCommandAttempts;
+  double m_commandLoss;
   Name m_name;
 
-  security::Identity m_identity;
-  std::vector<uint64_t> m_createdFaces;
-  std::unordered_map<Name, bool> m_handlerMaps;
-  std::unordered_map<Name, security::v2::Certificate> m_certificates;
+  security::Identity m_identity; // see getIdentity()
+  size_t m_nStartupSteps;
+  bool m_isReady;
+  bool m_exitWhenReady;
+
+  // only touched on the thread of the Face; work given to m_workers refers to nothing but
+  // a busy RequestContext, which the pool does not recycle until the work is back
+  ForwarderState m_forwarderState;
+  FaceManager m_faceManager;
+  std::unordered_set<NameTable::Id> m_filterPrefixes; // of listen()
+  bool m_isForwarderLost;
+  time::steady_clock::TimePoint m_forwarderLostAt;
+  util::scheduler::EventId m_reconnectEvent;
+  CommandDispatcher m_commands;
+  NameTable m_names;
+  std::unordered_map<NameTable::Id, shared_ptr<CommandRegistration>> m_registrations;
+  ObjectPool<RequestContext> m_requests;
+  std::unordered_map<NameTable::Id, TopPrefix> m_topPrefixes;
+  std::unordered_map<NameTable::Id, Block> m_certificates; // wire encodings, by key name
 };
 
 } // namespace iot
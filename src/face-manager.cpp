@@ -0,0 +1,213 @@
+#include "face-manager.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace ndn {
+namespace iot {
+
+NDN_IOT_LOG_INIT(faces);
+
+FaceManager::FaceManager(Face& face, nfd::Controller& controller, util::Scheduler& scheduler,
+			 const FaceManagerOptions& options, const GoneCallback& onFaceGone)
+  : m_controller(controller)
+  , m_scheduler(scheduler)
+  , m_options(options)
+  , m_onFaceGone(onFaceGone)
+  , m_monitor(face)
+  , m_wheel(std::max<size_t>(options.nSlots, 1))
+  , m_cursor(0)
+  , m_generation(0)
+  , m_tick(time::nanoseconds(options.idleTimeout) / static_cast<int64_t>(m_wheel.size()))
+  , m_isTurning(false)
+{
+  m_monitor.onNotification.connect(bind(&FaceManager::onNotification, this, _1));
+}
+
+void
+FaceManager::track(const std::string& uri)
+{
+  if (m_options.idleTimeout == time::seconds::zero()) {
+    return;
+  }
+
+  if (m_faces.count(uri) > 0) {
+    return touch(uri);
+  }
+  auto& entry = m_faces[uri];
+  entry.lastActivity = time::steady_clock::now();
+  entry.nPackets = 0;
+  entry.isSeeded = false;
+  schedule(uri, entry);
+
+  // the counters so far, so that the first check sees the traffic since
+  nfd::FaceQueryFilter filter;
+  filter.setRemoteUri(uri);
+  m_controller.fetch<nfd::FaceQueryDataset>(
+    filter,
+    [this, uri] (const std::vector<nfd::FaceStatus>& dataset) {
+      auto it = m_faces.find(uri);
+      if (it != m_faces.end() && !it->second.isSeeded && !dataset.empty()) {
+	it->second.nPackets = countPackets(dataset.front());
+	it->second.isSeeded = true;
+      }
+    },
+    [uri] (uint32_t code, const std::string& reason) {
+      LOG_DBG("no counters of the face toward " << uri << " (" << code << "): " << reason);
+    });
+
+  if (!m_isTurning) {
+    m_isTurning = true;
+    m_monitor.start();
+    m_scheduler.scheduleEvent(m_tick, bind(&FaceManager::onTick, this));
+  }
+}
+
+void
+FaceManager::touch(const std::string& uri)
+{
+  auto it = m_faces.find(uri);
+  if (it != m_faces.end()) {
+    it->second.lastActivity = time::steady_clock::now();
+  }
+}
+
+uint64_t
+FaceManager::countPackets(const nfd::FaceStatus& status)
+{
+  return status.getNInInterests() + status.getNInData() + status.getNInNacks() +
+	 status.getNOutInterests() + status.getNOutData() + status.getNOutNacks();
+}
+
+void
+FaceManager::schedule(const std::string& uri, Entry& entry)
+{
+  auto delay = entry.lastActivity + m_options.idleTimeout - time::steady_clock::now();
+  auto nTicks = std::max<int64_t>(1, (delay + m_tick - time::nanoseconds(1)) / m_tick);
+  nTicks = std::min<int64_t>(nTicks, m_wheel.size());
+  // an entry placed before is skipped by its generation
+  entry.generation = ++m_generation;
+  m_wheel[(m_cursor + nTicks) % m_wheel.size()].push_back({uri, entry.generation});
+}
+
+void
+FaceManager::onTick()
+{
+  if (m_faces.empty()) {
+    m_isTurning = false;
+    m_monitor.stop();
+    return;
+  }
+  m_scheduler.scheduleEvent(m_tick, bind(&FaceManager::onTick, this));
+
+  m_cursor = (m_cursor + 1) % m_wheel.size();
+  std::vector<SlotEntry> slot;
+  slot.swap(m_wheel[m_cursor]);
+
+  auto now = time::steady_clock::now();
+  std::vector<std::string> due;
+  for (const auto& slotEntry : slot) {
+    auto it = m_faces.find(slotEntry.uri);
+    if (it == m_faces.end() || it->second.generation != slotEntry.generation) {
+      continue; // forgotten or placed again since
+    }
+    if (it->second.lastActivity + m_options.idleTimeout > now) {
+      schedule(slotEntry.uri, it->second);
+    }
+    else {
+      due.push_back(slotEntry.uri);
+    }
+  }
+  if (due.empty()) {
+    return;
+  }
+
+  m_controller.fetch<nfd::FaceDataset>(
+    bind(&FaceManager::reapIdleFaces, this, due, _1),
+    [this, due] (uint32_t code, const std::string& reason) {
+      LOG_FAILURE("faces", "Error " << code << " when fetching faces: " << reason);
+      // try again in one turn
+      for (const auto& uri : due) {
+	auto it = m_faces.find(uri);
+	if (it != m_faces.end()) {
+	  it->second.lastActivity = time::steady_clock::now();
+	  schedule(uri, it->second);
+	}
+      }
+    });
+}
+
+void
+FaceManager::reapIdleFaces(const std::vector<std::string>& due,
+			   const std::vector<nfd::FaceStatus>& dataset)
+{
+  std::unordered_set<std::string> remaining(due.begin(), due.end());
+  for (const auto& status : dataset) {
+    auto uri = status.getRemoteUri();
+    if (remaining.erase(uri) == 0) {
+      continue;
+    }
+    auto it = m_faces.find(uri);
+    if (it == m_faces.end()) {
+      continue;
+    }
+
+    auto nPackets = countPackets(status);
+    if (!it->second.isSeeded || nPackets != it->second.nPackets) {
+      // without counters from the time it was tracked, a face gets one more turn
+      it->second.nPackets = nPackets;
+      it->second.isSeeded = true;
+      it->second.lastActivity = time::steady_clock::now();
+      schedule(uri, it->second);
+      continue;
+    }
+
+    LOG_DBG("destroy idle face " << status.getFaceId() << " (" << uri << ")");
+    Metrics::increment(Metrics::FACES_REAPED);
+    m_controller.start<nfd::FaceDestroyCommand>(
+      nfd::ControlParameters().setFaceId(status.getFaceId()),
+      bind([] {}),
+      [uri] (const nfd::ControlResponse& response) {
+	LOG_FAILURE("faces", "Error " << response.getCode() << " when destroying the face "
+		    << "toward " << uri << ": " << response.getText());
+      });
+    forget(uri);
+  }
+
+  // no longer in the forwarder
+  for (const auto& uri : remaining) {
+    if (m_faces.count(uri) > 0) {
+      forget(uri);
+    }
+  }
+}
+
+void
+FaceManager::onNotification(const nfd::FaceEventNotification& notification)
+{
+  auto uri = notification.getRemoteUri();
+  if (m_faces.count(uri) == 0) {
+    return;
+  }
+
+  if (notification.getKind() == nfd::FACE_EVENT_DESTROYED) {
+    LOG_DBG("face " << notification.getFaceId() << " (" << uri << ") is gone");
+    forget(uri);
+  }
+  else {
+    touch(uri);
+  }
+}
+
+void
+FaceManager::forget(const std::string& uri)
+{
+  // left in its slot, where it is skipped by its generation
+  m_faces.erase(uri);
+  m_onFaceGone(uri);
+}
+
+} // namespace iot
+} // namespace ndn
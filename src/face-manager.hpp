@@ -0,0 +1,115 @@
+#ifndef NDN_IOT_FACE_MANAGER_HPP
+#define NDN_IOT_FACE_MANAGER_HPP
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/mgmt/nfd/controller.hpp>
+#include <ndn-cxx/mgmt/nfd/face-monitor.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+struct FaceManagerOptions
+{
+  /** @brief destroy a face without traffic for this long; faces are kept if zero
+   */
+  time::seconds idleTimeout = time::seconds(600);
+
+  /** @brief slots of the timer wheel, which turns once per idle timeout
+   */
+  size_t nSlots = 60;
+};
+
+/** @brief Faces toward devices, destroyed once idle to free the forwarder
+ *
+ *  A face is known by its remote URI, which stays the same when the forwarder creates it
+ *  again under another ID.  Faces sit in a timer wheel at the slot of their idle deadline;
+ *  traffic only updates the last activity of a face, which is placed again when its slot
+ *  comes up, so the cost does not depend on the traffic.  Whether a face whose deadline
+ *  passed was used is told by its packet counters, fetched once per slot for all its due
+ *  faces and compared with those seen last, from the time it is tracked on, and by the
+ *  face events of the forwarder.
+ */
+class FaceManager : noncopyable
+{
+public:
+  /** @brief called with the URI of a face destroyed for idleness, or gone on its own
+   */
+  typedef std::function<void(const std::string& uri)> GoneCallback;
+
+  FaceManager(Face& face, nfd::Controller& controller, util::Scheduler& scheduler,
+	      const FaceManagerOptions& options, const GoneCallback& onFaceGone);
+
+  /** @brief destroy the face toward @p uri once idle
+   */
+  void
+  track(const std::string& uri);
+
+  /** @brief count traffic on the face toward @p uri
+   */
+  void
+  touch(const std::string& uri);
+
+  size_t
+  size() const
+  {
+    return m_faces.size();
+  }
+
+private:
+  struct Entry
+  {
+    time::steady_clock::TimePoint lastActivity;
+    uint64_t nPackets;
+    bool isSeeded; // nPackets is from the forwarder
+    uint64_t generation; // of its only live slot entry
+  };
+
+  struct SlotEntry
+  {
+    std::string uri;
+    uint64_t generation;
+  };
+
+  static uint64_t
+  countPackets(const nfd::FaceStatus& status);
+
+  void
+  schedule(const std::string& uri, Entry& entry);
+
+  void
+  onTick();
+
+  void
+  reapIdleFaces(const std::vector<std::string>& due,
+		const std::vector<nfd::FaceStatus>& dataset);
+
+  void
+  onNotification(const nfd::FaceEventNotification& notification);
+
+  void
+  forget(const std::string& uri);
+
+private:
+  nfd::Controller& m_controller;
+  util::Scheduler& m_scheduler;
+  FaceManagerOptions m_options;
+  GoneCallback m_onFaceGone;
+  nfd::FaceMonitor m_monitor;
+
+  std::unordered_map<std::string, Entry> m_faces;
+  std::vector<std::vector<SlotEntry>> m_wheel;
+  size_t m_cursor;
+  uint64_t m_generation;
+  time::nanoseconds m_tick;
+  bool m_isTurning;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_FACE_MANAGER_HPP
@@ -0,0 +1,210 @@
+#include "forwarder-state.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+namespace ndn {
+namespace iot {
+
+NDN_IOT_LOG_INIT(state);
+
+ForwarderState::ForwarderState(nfd::Controller& controller)
+  : m_controller(controller)
+{
+}
+
+void
+ForwarderState::addFace(uint64_t faceId, const std::string& uri, bool isReplayable)
+{
+  auto& record = m_faces[faceId];
+  record.uri = uri;
+  record.isReplayable = isReplayable;
+}
+
+void
+ForwarderState::removeFace(uint64_t faceId)
+{
+  m_faces.erase(faceId);
+}
+
+void
+ForwarderState::addRoute(const Name& prefix, uint64_t faceId)
+{
+  m_faces[faceId].routes.insert(prefix);
+}
+
+std::vector<uint64_t>
+ForwarderState::getFaceIds() const
+{
+  std::vector<uint64_t> faceIds;
+  for (const auto& entry : m_faces) {
+    if (!entry.second.uri.empty()) {
+      faceIds.push_back(entry.first);
+    }
+  }
+  return faceIds;
+}
+
+size_t
+ForwarderState::getNRoutes() const
+{
+  size_t nRoutes = 0;
+  for (const auto& entry : m_faces) {
+    nRoutes += entry.second.routes.size();
+  }
+  return nRoutes;
+}
+
+void
+ForwarderState::replay(const ReplayCallback& done)
+{
+  // faces recorded while replaying go straight into m_faces
+  std::map<uint64_t, FaceRecord> faces;
+  faces.swap(m_faces);
+
+  auto context = make_shared<ReplayContext>();
+  context->nPending = 1;
+  context->nFailures = 0;
+  context->done = done;
+
+  for (auto& entry : faces) {
+    if (entry.second.uri.empty()) {
+      LOG_DBG("drop " << entry.second.routes.size() << " routes on face " << entry.first
+	      << ", which was not created by this entity");
+      continue;
+    }
+    if (!entry.second.isReplayable) {
+      LOG_DBG("drop face " << entry.first << " (" << entry.second.uri << ") and its "
+	      << entry.second.routes.size() << " routes, which the remote end created");
+      continue;
+    }
+    ++context->nPending;
+    replayFace(context, std::move(entry.second));
+  }
+
+  // every command is issued
+  afterReplayStep(context, false);
+}
+
+bool
+ForwarderState::suspendFace(const std::string& uri)
+{
+  for (auto it = m_faces.begin(); it != m_faces.end(); ++it) {
+    if (it->second.uri != uri) {
+      continue;
+    }
+    for (const auto& prefix : it->second.routes) {
+      m_suspendedRoutes[prefix] = uri;
+    }
+    m_suspendedFaces[uri] = std::move(it->second);
+    m_faces.erase(it);
+    return true;
+  }
+  return false;
+}
+
+bool
+ForwarderState::restoreFace(const Name& name, const RestoreCallback& done)
+{
+  if (m_suspendedRoutes.empty()) {
+    return false;
+  }
+
+  // longest prefix match over the suspended routes
+  auto route = m_suspendedRoutes.end();
+  for (size_t length = name.size() + 1; length-- > 0 && route == m_suspendedRoutes.end(); ) {
+    route = m_suspendedRoutes.find(name.getPrefix(length));
+  }
+  if (route == m_suspendedRoutes.end()) {
+    return false;
+  }
+  auto uri = route->second;
+
+  auto restoring = m_restoringFaces.find(uri);
+  if (restoring != m_restoringFaces.end()) {
+    restoring->second.push_back(done);
+    return true;
+  }
+
+  auto suspended = m_suspendedFaces.find(uri);
+  FaceRecord record = std::move(suspended->second);
+  m_suspendedFaces.erase(suspended);
+  for (const auto& prefix : record.routes) {
+    m_suspendedRoutes.erase(prefix);
+  }
+  m_restoringFaces[uri].push_back(done);
+
+  auto context = make_shared<ReplayContext>();
+  context->nPending = 1;
+  context->nFailures = 0;
+  context->done = [this, uri] (size_t nFailures) {
+    if (nFailures == 0) {
+      Metrics::increment(Metrics::FACES_RESTORED);
+    }
+    auto waiters = std::move(m_restoringFaces[uri]);
+    m_restoringFaces.erase(uri);
+    for (const auto& waiter : waiters) {
+      waiter(uri, nFailures == 0);
+    }
+  };
+  replayFace(context, std::move(record));
+  return true;
+}
+
+void
+ForwarderState::replayFace(const shared_ptr<ReplayContext>& context, FaceRecord record)
+{
+  auto uri = record.uri;
+  auto routes = make_shared<std::set<Name>>(std::move(record.routes));
+  auto onFace = [this, context, uri, routes] (const nfd::ControlParameters& face) {
+    auto& restored = m_faces[face.getFaceId()];
+    restored.uri = uri;
+    context->nPending += routes->size();
+    for (const auto& prefix : *routes) {
+      restored.routes.insert(prefix);
+
+      nfd::ControlParameters ribParameters;
+      ribParameters
+	.setName(prefix)
+	.setFaceId(face.getFaceId())
+	.setCost(0)
+	.setExpirationPeriod(time::milliseconds::max());
+      m_controller.start<nfd::RibRegisterCommand>(
+	ribParameters,
+	bind(&ForwarderState::afterReplayStep, this, context, false),
+	[this, context, prefix] (const nfd::ControlResponse& response) {
+	  LOG_FAILURE("replay", "Error " << response.getCode() << " when registering "
+		      << prefix << ": " << response.getText());
+	  afterReplayStep(context, true);
+	});
+    }
+    afterReplayStep(context, false);
+  };
+
+  m_controller.start<nfd::FaceCreateCommand>(
+    nfd::ControlParameters().setUri(uri),
+    onFace,
+    [this, context, uri, onFace] (const nfd::ControlResponse& response) {
+      if (response.getCode() == 409) {
+	// the face came back on its own, e.g. from the configuration of the forwarder
+	return onFace(nfd::ControlParameters(response.getBody()));
+      }
+      LOG_FAILURE("replay", "Error " << response.getCode() << " when creating face "
+		  << uri << ": " << response.getText());
+      afterReplayStep(context, true);
+    });
+}
+
+void
+ForwarderState::afterReplayStep(const shared_ptr<ReplayContext>& context, bool isFailed)
+{
+  if (isFailed) {
+    ++context->nFailures;
+  }
+  if (--context->nPending > 0) {
+    return;
+  }
+  context->done(context->nFailures);
+}
+
+} // namespace iot
+} // namespace ndn
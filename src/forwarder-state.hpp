@@ -0,0 +1,113 @@
+#ifndef NDN_IOT_FORWARDER_STATE_HPP
+#define NDN_IOT_FORWARDER_STATE_HPP
+
+#include <ndn-cxx/mgmt/nfd/controller.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief The faces and routes an entity asked the forwarder for
+ *
+ *  A forwarder that restarts forgets them all, and the faces it creates again get new
+ *  IDs, so a face is recorded with its URI and a route with the face it goes through.
+ *  replay() creates every face again and registers its routes on its new ID as soon as
+ *  it exists, with all commands in flight at once.  A route on a face that was not
+ *  recorded, e.g. a multicast face, or on a face the remote end created, cannot be replayed
+ *  and is left to its owner.
+ *
+ *  A face destroyed while idle is kept suspended with its routes, and restoreFace()
+ *  brings it back the same way when a name it routes is next addressed.
+ */
+class ForwarderState : noncopyable
+{
+public:
+  typedef std::function<void(size_t nFailures)> ReplayCallback;
+  typedef std::function<void(const std::string& uri, bool isRestored)> RestoreCallback;
+
+  explicit
+  ForwarderState(nfd::Controller& controller);
+
+  /** @brief record a face toward @p uri, created by or for this entity
+   *  @param isReplayable whether replay() can create the face again toward @p uri, which an
+   *         on-demand face created by the remote end cannot, e.g. with the ephemeral port
+   *         of a TCP connection as its URI
+   */
+  void
+  addFace(uint64_t faceId, const std::string& uri, bool isReplayable = true);
+
+  /** @brief forget a face and its routes
+   */
+  void
+  removeFace(uint64_t faceId);
+
+  void
+  addRoute(const Name& prefix, uint64_t faceId);
+
+  std::vector<uint64_t>
+  getFaceIds() const;
+
+  size_t
+  getNRoutes() const;
+
+  /** @brief create every face again, then register its routes on its new ID
+   *  @param done called with the number of faces and routes that failed, once every
+   *         command is answered; a face that fails is forgotten with its routes
+   */
+  void
+  replay(const ReplayCallback& done);
+
+  /** @brief keep the face toward @p uri and its routes aside, until restoreFace()
+   *  @return whether such a face was recorded
+   */
+  bool
+  suspendFace(const std::string& uri);
+
+  /** @brief create the suspended face that routes @p name again, with its routes
+   *  @param done called once every command is answered; if the face is being restored
+   *         already, it is queued and called when that restoration completes; a face that
+   *         fails is forgotten with its routes
+   *  @return whether a suspended face routes @p name; @p done is not called otherwise
+   */
+  bool
+  restoreFace(const Name& name, const RestoreCallback& done);
+
+private:
+  struct FaceRecord
+  {
+    std::string uri;
+    std::set<Name> routes;
+    bool isReplayable = true;
+  };
+
+  struct ReplayContext
+  {
+    size_t nPending;
+    size_t nFailures;
+    ReplayCallback done;
+  };
+
+  void
+  replayFace(const shared_ptr<ReplayContext>& context, FaceRecord record);
+
+  void
+  afterReplayStep(const shared_ptr<ReplayContext>& context, bool isFailed);
+
+private:
+  nfd::Controller& m_controller;
+  std::map<uint64_t, FaceRecord> m_faces;
+
+  // by URI, with the routes they had
+  std::map<std::string, FaceRecord> m_suspendedFaces;
+  std::map<Name, std::string> m_suspendedRoutes;
+  std::map<std::string, std::vector<RestoreCallback>> m_restoringFaces;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_FORWARDER_STATE_HPP
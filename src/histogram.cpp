@@ -0,0 +1,106 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace ndn {
+namespace iot {
+
+const int Histogram::SUB_BUCKET_BITS;
+const size_t Histogram::SUB_BUCKETS;
+const size_t Histogram::N_BUCKETS;
+
+Histogram::Histogram()
+{
+  reset();
+}
+
+size_t
+Histogram::getBucketIndex(uint64_t value)
+{
+  if (value < SUB_BUCKETS) {
+    return value;
+  }
+
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - SUB_BUCKET_BITS;
+  return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t
+Histogram::getBucketValue(size_t index)
+{
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+
+  int shift = index / SUB_BUCKETS - 1;
+  return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+void
+Histogram::record(uint64_t value)
+{
+  ++m_buckets[getBucketIndex(value)];
+  ++m_count;
+  m_sum += value;
+  m_min = std::min(m_min, value);
+  m_max = std::max(m_max, value);
+}
+
+void
+Histogram::merge(const Histogram& other)
+{
+  for (size_t i = 0; i < N_BUCKETS; ++i) {
+    m_buckets[i] += other.m_buckets[i];
+  }
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+}
+
+void
+Histogram::reset()
+{
+  m_buckets.fill(0);
+  m_count = 0;
+  m_sum = 0;
+  m_min = std::numeric_limits<uint64_t>::max();
+  m_max = 0;
+}
+
+uint64_t
+Histogram::getPercentile(double percentile) const
+{
+  if (m_count == 0) {
+    return 0;
+  }
+
+  uint64_t rank = static_cast<uint64_t>(percentile / 100 * m_count + 0.5);
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < N_BUCKETS; ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      return std::min(std::max(getBucketValue(i), getMin()), m_max);
+    }
+  }
+  return m_max;
+}
+
+std::ostream&
+operator<<(std::ostream& os, const Histogram& histogram)
+{
+  return os << "n=" << histogram.getCount()
+	    << " mean=" << histogram.getMean()
+	    << " p50=" << histogram.getPercentile(50)
+	    << " p90=" << histogram.getPercentile(90)
+	    << " p99=" << histogram.getPercentile(99)
+	    << " p99.9=" << histogram.getPercentile(99.9)
+	    << " max=" << histogram.getMax();
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,94 @@
+#ifndef NDN_IOT_HISTOGRAM_HPP
+#define NDN_IOT_HISTOGRAM_HPP
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Log-linear latency histogram in the style of HdrHistogram
+ *
+ *  Every power of two is split into 16 linear sub-buckets, so any recorded value is
+ *  reported within 1/16 (6.25%) of its magnitude, and recording is a few bit operations
+ *  into a fixed array.  Values are unit-less; callers record microseconds.
+ */
+class Histogram
+{
+public:
+  static const int SUB_BUCKET_BITS = 4;
+  static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const size_t N_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  Histogram();
+
+  void
+  record(uint64_t value);
+
+  void
+  merge(const Histogram& other);
+
+  void
+  reset();
+
+  uint64_t
+  getCount() const
+  {
+    return m_count;
+  }
+
+  uint64_t
+  getMin() const
+  {
+    return m_count == 0 ? 0 : m_min;
+  }
+
+  uint64_t
+  getMax() const
+  {
+    return m_max;
+  }
+
+  double
+  getMean() const
+  {
+    return m_count == 0 ? 0 : static_cast<double>(m_sum) / m_count;
+  }
+
+  /** @return the lowest value at or below which @p percentile percent of the values fall
+   */
+  uint64_t
+  getPercentile(double percentile) const;
+
+  const std::array<uint64_t, N_BUCKETS>&
+  getBuckets() const
+  {
+    return m_buckets;
+  }
+
+  static size_t
+  getBucketIndex(uint64_t value);
+
+  /** @return the lowest value that falls into bucket @p index
+   */
+  static uint64_t
+  getBucketValue(size_t index);
+
+private:
+  std::array<uint64_t, N_BUCKETS> m_buckets;
+  uint64_t m_count;
+  uint64_t m_sum;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+/** @brief Print count, mean, p50/p90/p99/p99.9 and max
+ */
+std::ostream&
+operator<<(std::ostream& os, const Histogram& histogram);
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_HISTOGRAM_HPP
@@ -1,5 +1,6 @@
 #include "hmac-helper.hpp"
 #include "control-parameters.hpp"
+#include "metrics.hpp"
 
 #include <ndn-cxx/interest.hpp>
 #include <ndn-cxx/data.hpp>
@@ -14,6 +15,9 @@ namespace ndn {
 namespace iot {
 namespace hmac {
 
+// the TLV of an HMAC-SHA256 signature value
+static const size_t SIGNATURE_VALUE_SIZE = 2 + 32;
+
 static Block
 makeHMACSignatureInfo()
 {
@@ -24,6 +28,15 @@ makeHMACSignatureInfo()
   return info;
 }
 
+/** @brief the SignatureInfo of every HMAC signature, encoded once and shared
+ */
+static const Block&
+getHMACSignatureInfo()
+{
+  static const Block info = makeHMACSignatureInfo();
+  return info;
+}
+
 static Block
 makeHMACSignatureValue(const uint8_t* buffer, size_t bufferLength,
 			       const std::string& pin)
@@ -45,8 +58,9 @@ makeHMACSignatureValue(const uint8_t* buffer, size_t bufferLength,
 void
 signInterest(Interest& interest, const std::string& pin)
 {
+  Metrics::ScopedTimer timer(Metrics::HMAC_SIGN_TIME);
   auto signedName = interest.getName();
-  auto nameBlock = signedName.append(makeHMACSignatureInfo()).wireEncode();
+  auto nameBlock = signedName.append(getHMACSignatureInfo()).wireEncode();
   auto sigValue = makeHMACSignatureValue(nameBlock.value(), nameBlock.value_size(), pin);
  
   interest.setName(signedName.append(sigValue));
@@ -55,9 +69,14 @@ signInterest(Interest& interest, const std::string& pin)
 void
 signData(Data& data, const std::string& pin)
 {
-  data.setSignature(Signature(makeHMACSignatureInfo()));
-  
-  EncodingBuffer encoder;
+  Metrics::ScopedTimer timer(Metrics::HMAC_SIGN_TIME);
+  data.setSignature(Signature(getHMACSignatureInfo()));
+
+  // encode into a buffer of the exact size of the signed Data, not of a whole packet
+  EncodingEstimator estimator;
+  size_t valueSize = data.wireEncode(estimator, true) + SIGNATURE_VALUE_SIZE;
+  size_t headerSize = tlv::sizeOfVarNumber(tlv::Data) + tlv::sizeOfVarNumber(valueSize);
+  EncodingBuffer encoder(headerSize + valueSize, SIGNATURE_VALUE_SIZE);
   data.wireEncode(encoder, true);
   
   auto sigValue = makeHMACSignatureValue(encoder.buf(), encoder.size(), pin);
@@ -67,6 +86,7 @@ signData(Data& data, const std::string& pin)
 bool
 verifyInterest(const Interest& interest, const std::string& pin)
 {
+  Metrics::ScopedTimer timer(Metrics::HMAC_VERIFY_TIME);
   Name interestName = interest.getName();
   
   if (interestName.size() < signed_interest::MIN_SIZE) {
@@ -88,6 +108,7 @@ verifyInterest(const Interest& interest, const std::string& pin)
 bool
 verifyData(const Data& data, const std::string& pin)
 {
+  Metrics::ScopedTimer timer(Metrics::HMAC_VERIFY_TIME);
   try {
     const auto& signature = data.getSignature();
     return signature.getValue() ==
@@ -0,0 +1,81 @@
+#include "interest-aggregator.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "packet-capture.hpp"
+
+namespace ndn {
+namespace iot {
+
+NDN_IOT_LOG_INIT(aggregator);
+
+InterestAggregator::InterestAggregator(Face& face)
+  : m_face(face)
+{
+}
+
+std::string
+InterestAggregator::makeKey(const Interest& interest)
+{
+  // the Name TLV delimits itself, so the concatenation is unambiguous
+  const auto& name = interest.getName().wireEncode();
+  auto selectors = interest.getSelectors().wireEncode();
+  std::string key(reinterpret_cast<const char*>(name.wire()), name.size());
+  key.append(reinterpret_cast<const char*>(selectors.wire()), selectors.size());
+  return key;
+}
+
+void
+InterestAggregator::expressInterest(const Interest& interest,
+				    const DataCallback& afterSatisfied,
+				    const NackCallback& afterNacked,
+				    const TimeoutCallback& afterTimeout)
+{
+  auto key = makeKey(interest);
+  auto& waiters = m_pending[key];
+  waiters.push_back({interest, afterSatisfied, afterNacked, afterTimeout});
+
+  if (waiters.size() > 1) {
+    Metrics::increment(Metrics::INTEREST_AGGREGATED);
+    LOG_DBG("aggregate " << interest.getName() << " with " << waiters.size() - 1
+	    << " pending");
+    return;
+  }
+
+  Metrics::increment(Metrics::INTEREST_EXPRESSED);
+  capturePacket(interest, capture::OUTGOING);
+  LOG_INTEREST_OUT(interest);
+  m_face.expressInterest(interest,
+			 [this, key] (const Interest&, const Data& data) {
+			   capturePacket(data, capture::INCOMING);
+			   LOG_DATA_IN(data);
+			   for (const auto& waiter : takeWaiters(key)) {
+			     waiter.afterSatisfied(waiter.interest, data);
+			   }
+			 },
+			 [this, key] (const Interest&, const lp::Nack& nack) {
+			   for (const auto& waiter : takeWaiters(key)) {
+			     waiter.afterNacked(waiter.interest, nack);
+			   }
+			 },
+			 [this, key] (const Interest&) {
+			   for (const auto& waiter : takeWaiters(key)) {
+			     waiter.afterTimeout(waiter.interest);
+			   }
+			 });
+}
+
+std::vector<InterestAggregator::Waiter>
+InterestAggregator::takeWaiters(const std::string& key)
+{
+  // a waiter may express the same Interest again from its callback, which starts anew
+  std::vector<Waiter> waiters;
+  auto it = m_pending.find(key);
+  if (it != m_pending.end()) {
+    waiters.swap(it->second);
+    m_pending.erase(it);
+  }
+  return waiters;
+}
+
+} // namespace iot
+} // namespace ndn
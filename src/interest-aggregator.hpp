@@ -0,0 +1,60 @@
+#ifndef NDN_IOT_INTEREST_AGGREGATOR_HPP
+#define NDN_IOT_INTEREST_AGGREGATOR_HPP
+
+#include <ndn-cxx/face.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Application-level pending Interest table in front of a Face
+ *
+ *  An Interest identical (same name and selectors) to one still pending is not sent
+ *  again; it waits for the outcome of the pending one.  The Data, Nack or timeout is
+ *  delivered to every waiter with its own Interest, which saves an Interest, a PIT
+ *  lookup in the forwarder and a Data per aggregated Interest.
+ */
+class InterestAggregator : noncopyable
+{
+public:
+  explicit
+  InterestAggregator(Face& face);
+
+  void
+  expressInterest(const Interest& interest,
+		  const DataCallback& afterSatisfied,
+		  const NackCallback& afterNacked,
+		  const TimeoutCallback& afterTimeout);
+
+  size_t
+  size() const
+  {
+    return m_pending.size();
+  }
+
+private:
+  struct Waiter
+  {
+    Interest interest;
+    DataCallback afterSatisfied;
+    NackCallback afterNacked;
+    TimeoutCallback afterTimeout;
+  };
+
+  static std::string
+  makeKey(const Interest& interest);
+
+  std::vector<Waiter>
+  takeWaiters(const std::string& key);
+
+private:
+  Face& m_face;
+  std::unordered_map<std::string, std::vector<Waiter>> m_pending;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_INTEREST_AGGREGATOR_HPP
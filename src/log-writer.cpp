@@ -0,0 +1,156 @@
+#include "log-writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+
+namespace ndn {
+namespace iot {
+
+static const size_t MAX_BATCH_SIZE = 64 * 1024;
+static const std::chrono::milliseconds IDLE_WAIT(10);
+
+const size_t LogWriter::RECORD_SIZE;
+const size_t LogWriter::N_RECORDS;
+
+static_assert((LogWriter::N_RECORDS & (LogWriter::N_RECORDS - 1)) == 0,
+	      "N_RECORDS must be a power of two");
+
+LogWriter::LogWriter(int fd)
+  : m_fd(fd)
+  , m_slots(new Slot[N_RECORDS])
+  , m_enqueuePos(0)
+  , m_dequeuePos(0)
+  , m_nDropped(0)
+  , m_nReportedDrops(0)
+  , m_isIdle(false)
+  , m_shouldStop(false)
+{
+  for (size_t i = 0; i < N_RECORDS; ++i) {
+    m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  m_thread = std::thread(&LogWriter::drain, this);
+}
+
+LogWriter::~LogWriter()
+{
+  m_shouldStop = true;
+  m_cv.notify_one();
+  m_thread.join();
+
+  delete[] m_slots;
+}
+
+LogWriter&
+LogWriter::getInstance()
+{
+  static LogWriter writer(STDERR_FILENO);
+  return writer;
+}
+
+bool
+LogWriter::push(const char* record, size_t size)
+{
+  size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &m_slots[pos & (N_RECORDS - 1)];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+	break;
+      }
+    }
+    else if (diff < 0) {
+      m_nDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    else {
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->size = std::min(size, RECORD_SIZE);
+  std::memcpy(slot->record, record, slot->size);
+  if (size > RECORD_SIZE) {
+    slot->record[RECORD_SIZE - 1] = '\n';
+  }
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  if (m_isIdle.load(std::memory_order_relaxed)) {
+    m_cv.notify_one();
+  }
+  return true;
+}
+
+bool
+LogWriter::pop(std::string& batch)
+{
+  Slot& slot = m_slots[m_dequeuePos & (N_RECORDS - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+    return false;
+  }
+
+  batch.append(slot.record, slot.size);
+  slot.sequence.store(m_dequeuePos + N_RECORDS, std::memory_order_release);
+  ++m_dequeuePos;
+  return true;
+}
+
+void
+LogWriter::drain()
+{
+  std::string batch;
+  batch.reserve(MAX_BATCH_SIZE + RECORD_SIZE);
+
+  while (true) {
+    batch.clear();
+    while (batch.size() < MAX_BATCH_SIZE && pop(batch)) {
+    }
+
+    uint64_t nDropped = getNDropped();
+    if (nDropped != m_nReportedDrops) {
+      batch += "[" + std::to_string(nDropped - m_nReportedDrops) + " log records dropped]\n";
+      m_nReportedDrops = nDropped;
+    }
+
+    if (!batch.empty()) {
+      writeAll(batch);
+      continue;
+    }
+
+    if (m_shouldStop) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_isIdle = true;
+    m_cv.wait_for(lock, IDLE_WAIT);
+    m_isIdle = false;
+  }
+}
+
+void
+LogWriter::writeAll(const std::string& batch)
+{
+  const char* buf = batch.data();
+  size_t remaining = batch.size();
+  while (remaining > 0) {
+    ssize_t nWritten = ::write(m_fd, buf, remaining);
+    if (nWritten < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      return;
+    }
+    buf += nWritten;
+    remaining -= nWritten;
+  }
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,91 @@
+#ifndef NDN_IOT_LOG_WRITER_HPP
+#define NDN_IOT_LOG_WRITER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Asynchronous writer of pre-formatted log records
+ *
+ *  Producers push records into a bounded lock-free ring (a multi-producer
+ *  sequence-numbered queue), and a background thread drains it with one write()
+ *  per batch.  push() never blocks: when the ring is full the record is dropped and
+ *  counted, and the writer reports the number of lost records on its next batch.
+ */
+class LogWriter
+{
+public:
+  static const size_t RECORD_SIZE = 1024;
+  static const size_t N_RECORDS = 1024; // must be a power of two
+
+  explicit
+  LogWriter(int fd);
+
+  ~LogWriter();
+
+  LogWriter(const LogWriter&) = delete;
+
+  LogWriter&
+  operator=(const LogWriter&) = delete;
+
+  /** @brief Enqueue one record, truncated to RECORD_SIZE bytes
+   *  @return false if the ring was full and the record was dropped
+   */
+  bool
+  push(const char* record, size_t size);
+
+  uint64_t
+  getNDropped() const
+  {
+    return m_nDropped.load(std::memory_order_relaxed);
+  }
+
+  /** @brief the process-wide writer to stderr
+   */
+  static LogWriter&
+  getInstance();
+
+private:
+  bool
+  pop(std::string& batch);
+
+  void
+  drain();
+
+  void
+  writeAll(const std::string& batch);
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    size_t size;
+    char record[RECORD_SIZE];
+  };
+
+  int m_fd;
+  Slot* m_slots;
+  std::atomic<size_t> m_enqueuePos;
+  size_t m_dequeuePos;
+
+  std::atomic<uint64_t> m_nDropped;
+  uint64_t m_nReportedDrops;
+
+  std::atomic<bool> m_isIdle;
+  std::atomic<bool> m_shouldStop;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::thread m_thread;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_LOG_WRITER_HPP
@@ -1,4 +1,5 @@
 #include "logger.hpp"
+#include "log-writer.hpp"
 #include "control-parameters.hpp"
 #include <ndn-cxx/util/time.hpp>
 #include <cinttypes>
@@ -7,11 +8,15 @@
 #include <ndn-cxx/encoding/tlv.hpp>
 #include <ndn-cxx/signature-info.hpp>
 
+#include <boost/algorithm/string.hpp>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+
 namespace ndn {
 namespace iot {
 
-std::basic_ofstream<uint8_t> globalPacketFile;
-
 static std::string
 getKey(const SignatureInfo& info)
 {
@@ -55,6 +60,7 @@ printInfoFromInterest(const std::string& msg, const Interest& interest)
   catch (const tlv::Error&) {
   }
   
+  std::ostringstream os;
   if (hasSignature) {
     SignatureInfo info(name.get(-2).blockFromValue());
     auto key = getKey(info);
@@ -62,20 +68,23 @@ printInfoFromInterest(const std::string& msg, const Interest& interest)
     ControlParameters params;
     try {
       params.wireDecode(name.get(-5).blockFromValue());
-      std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-		<< "\033[1;31m" << name.getPrefix(-5) << "\033[0m" << params << "\n"
-		<< "SIGNED BY \033[1m " << key << "\033[0m" << std::endl;
+      os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+	 << "\033[1;31m" << name.getPrefix(-5) << "\033[0m" << params << "\n"
+	 << "SIGNED BY \033[1m " << key << "\033[0m\n";
     }
     catch (const tlv::Error&) {
-      std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-		<< "\033[1;31m" << name.getPrefix(-4) << "\033[0m\n"
-		<< "SIGNED BY \033[1m " << key << "\033[0m" << std::endl;
+      os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+	 << "\033[1;31m" << name.getPrefix(-4) << "\033[0m\n"
+	 << "SIGNED BY \033[1m " << key << "\033[0m\n";
     }
   }
   else {
-    std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-	      << "\033[31m" << name << "\033[0m" << std::endl;
+    os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+       << "\033[31m" << name << "\033[0m\n";
   }
+
+  os << LOG_DOT_LINE_TEXT;
+  logRecord(os.str());
 }
 
 void printInfoFromData(const std::string& msg, const Data& data)
@@ -93,9 +102,11 @@ void printInfoFromData(const std::string& msg, const Data& data)
   catch (const tlv::Error&) {
   }
 
+  std::ostringstream os;
   if (!hasSignature) {
-    std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-	      << name << std::endl;
+    os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+       << name << "\n" << LOG_DOT_LINE_TEXT;
+    logRecord(os.str());
     return;
   }
 
@@ -108,36 +119,140 @@ void printInfoFromData(const std::string& msg, const Data& data)
   ControlParameters params;
   try {
     params.wireDecode(name.get(-6).blockFromValue());
-    std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-	      << "\033[1;32m" << name.getPrefix(-6) << "\033[0m" << params
-	      << "[SIG=" << key << "][V=" << name.get(-1).toVersion() << "]\n"
-	      << "SIGNED BY \033[1m " << dataKey << "\033[0m" << std::endl;
+    os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+       << "\033[1;32m" << name.getPrefix(-6) << "\033[0m" << params
+       << "[SIG=" << key << "][V=" << name.get(-1).toVersion() << "]\n"
+       << "SIGNED BY \033[1m " << dataKey << "\033[0m\n";
   }
   catch (const tlv::Error&) {
-    std::cerr << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
-	      << "\033[1;32m" << name.getPrefix(-5) << "\033[0m"
-	      << "[SIG=" << key << "][V=" << name.get(-1).toVersion() << "]\n"
-	      << "SIGNED BY \033[1m " << dataKey << "\033[0m" << std::endl;
-  }  
+    os << "[" << LoggerTimestamp{} << "][" << msg << "]:\n"
+       << "\033[1;32m" << name.getPrefix(-5) << "\033[0m"
+       << "[SIG=" << key << "][V=" << name.get(-1).toVersion() << "]\n"
+       << "SIGNED BY \033[1m " << dataKey << "\033[0m\n";
+  }
+
+  os << LOG_DOT_LINE_TEXT;
+  logRecord(os.str());
 }
 
-void
-writeToFile(const Block& block)
-{					
-  if (!globalPacketFile.is_open()) {				
-      globalPacketFile.open("packet.out", std::ios::out | std::ios::binary); 
+namespace {
+
+#ifdef DEBUG
+const int DEFAULT_LOG_LEVEL = NDN_IOT_LOG_DEBUG;
+#else
+const int DEFAULT_LOG_LEVEL = NDN_IOT_LOG_TRACE;
+#endif
+
+int
+parseLogLevel(const std::string& level)
+{
+  static const std::map<std::string, int> LEVELS = {
+    {"NONE", NDN_IOT_LOG_NONE},
+    {"ERROR", NDN_IOT_LOG_ERROR},
+    {"INFO", NDN_IOT_LOG_INFO},
+    {"TRACE", NDN_IOT_LOG_TRACE},
+    {"DEBUG", NDN_IOT_LOG_DEBUG}
+  };
+
+  auto it = LEVELS.find(boost::to_upper_copy(level));
+  return it == LEVELS.end() ? DEFAULT_LOG_LEVEL : it->second;
+}
+
+struct LogModuleRegistry
+{
+  LogModuleRegistry()
+    : defaultLevel(DEFAULT_LOG_LEVEL)
+  {
+    const char* config = std::getenv("NDN_IOT_LOG");
+    if (config == nullptr) {
+      return;
+    }
+
+    std::vector<std::string> entries;
+    boost::split(entries, config, boost::is_any_of(","));
+    for (const auto& entry : entries) {
+      auto pos = entry.find('=');
+      if (pos == std::string::npos) {
+	continue;
+      }
+      auto name = boost::trim_copy(entry.substr(0, pos));
+      auto level = parseLogLevel(boost::trim_copy(entry.substr(pos + 1)));
+      if (name == "*") {
+	defaultLevel = level;
+      }
+      else {
+	levels[name] = level;
+      }
+    }
+  }
+
+  int
+  getLevel(const std::string& name) const
+  {
+    auto it = levels.find(name);
+    return it == levels.end() ? defaultLevel : it->second;
+  }
+
+  std::mutex mutex;
+  int defaultLevel;
+  std::map<std::string, int> levels;
+  std::map<std::string, std::unique_ptr<LogModule>> modules;
+};
+
+LogModuleRegistry&
+getLogModuleRegistry()
+{
+  static LogModuleRegistry registry;
+  return registry;
+}
+
+} // namespace
+
+LogModule::LogModule(const std::string& name, int level)
+  : m_name(name)
+  , m_level(level)
+{
+}
+
+LogModule&
+LogModule::get(const std::string& name)
+{
+  auto& registry = getLogModuleRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  auto& module = registry.modules[name];
+  if (module == nullptr) {
+    module.reset(new LogModule(name, registry.getLevel(name)));
   }
-  const uint8_t* buf = block.wire();
-  size_t buf_size = block.size();
+  return *module;
+}
 
-  // write the size first, so the reader can be aware of how many bytes to read next
-  globalPacketFile.write(reinterpret_cast<uint8_t*>(&buf_size), sizeof(size_t));
+void
+LogModule::setLevel(const std::string& name, int level)
+{
+  auto& registry = getLogModuleRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
 
-  // write the whole buf into file in the binary format
-  globalPacketFile.write(buf, buf_size);
+  if (name == "*") {
+    registry.defaultLevel = level;
+    registry.levels.clear();
+    for (auto& entry : registry.modules) {
+      entry.second->m_level = level;
+    }
+    return;
+  }
 
-  // flush to file rather than buffered the content
-  globalPacketFile.flush();
+  registry.levels[name] = level;
+  auto it = registry.modules.find(name);
+  if (it != registry.modules.end()) {
+    it->second->m_level = level;
+  }
+}
+
+void
+logRecord(const std::string& record)
+{
+  LogWriter::getInstance().push(record.data(), record.size());
 }
 
 std::ostream&
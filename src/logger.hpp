@@ -6,7 +6,9 @@
 #include <ndn-cxx/encoding/block.hpp>
 #include <ndn-cxx/interest.hpp>
 #include <ndn-cxx/data.hpp>
+#include <atomic>
 #include <fstream>
+#include <sstream>
 
 /*
          foreground background
@@ -37,65 +39,152 @@ struct LoggerTimestamp
 {
 };
 
-extern std::basic_ofstream<uint8_t> globalPacketFile;
-
-void
-writeToFile(const Block& block);
-  
 std::ostream&
 operator<<(std::ostream& os, const LoggerTimestamp&);
 
 #define LOG_LINE(msg, expression) \
   LoggerTimestamp{} << " "#msg": " << expression;
 
-#define LOG_DOT_LINE std::cerr << "------------------------------------------------------------------" << std::endl;
+/** @brief Format a record and hand it to the background LogWriter
+ *
+ *  The caller never waits for stderr; see LogWriter for the drop policy.
+ */
+void
+logRecord(const std::string& record);
+
+#define LOG_RECORD(expression) {					\
+    std::ostringstream os_;						\
+    os_ << expression;							\
+    ::ndn::iot::logRecord(os_.str());					\
+}
 
-#define LOG_WELCOME(role, name)						\
-  std::cerr << "##########################################################\n" \
-            << "# THE [" << role << "] NAMED [" << name << "] IS RUNNING " 		\
-            << "\n##########################################################"	\
-            << std::endl
-
-#define LOG_BYEBYE(name, msg) \
-  std::cerr << "+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n" \
-            << "+ [" << name << "] IS GOING TO BE TERMINATED " << msg			\
-            << "\n+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"	\
-            << std::endl
-
-#define LOG_STEP(idx, msg) {						\
-    LOG_DOT_LINE							\
-    std::cerr << "- [STEP " << idx << "]: " << msg << std::endl;	\
-    LOG_DOT_LINE							\
+#define LOG_DOT_LINE_TEXT "------------------------------------------------------------------\n"
+
+#define LOG_DOT_LINE LOG_RECORD(LOG_DOT_LINE_TEXT)
+
+/** @brief Verbosity levels, each one including the ones before it
+ *
+ *  Packet tracing sits below DEBUG so that the default level keeps the packet trace
+ *  without the debug chatter.
+ */
+#define NDN_IOT_LOG_NONE    0
+#define NDN_IOT_LOG_ERROR   1
+#define NDN_IOT_LOG_INFO    2
+#define NDN_IOT_LOG_TRACE   3
+#define NDN_IOT_LOG_DEBUG   4
+
+/** @brief Most verbose level compiled in; statements above it generate no code at all
+ *
+ *  A production build can pass e.g. -DNDN_IOT_LOG_MAX_LEVEL=NDN_IOT_LOG_INFO.
+ */
+#ifndef NDN_IOT_LOG_MAX_LEVEL
+#define NDN_IOT_LOG_MAX_LEVEL NDN_IOT_LOG_DEBUG
+#endif
+
+/** @brief Runtime log level of one module
+ *
+ *  Levels are read from the NDN_IOT_LOG environment variable, which is a comma separated
+ *  list of module=LEVEL, e.g. "entity=DEBUG,broadcast=ERROR,*=INFO".  The default level is
+ *  TRACE, or DEBUG when built with DEBUG defined.
+ */
+class LogModule
+{
+public:
+  static LogModule&
+  get(const std::string& name);
+
+  /** @brief Set the level of a module, or of all modules if @p name is "*"
+   */
+  static void
+  setLevel(const std::string& name, int level);
+
+  bool
+  isEnabled(int level) const
+  {
+    return level <= m_level.load(std::memory_order_relaxed);
+  }
+
+  const std::string&
+  getName() const
+  {
+    return m_name;
+  }
+
+private:
+  LogModule(const std::string& name, int level);
+
+private:
+  std::string m_name;
+  std::atomic<int> m_level;
+};
+
+/** @brief Declare the log module of a translation unit, required by the LOG_* macros
+ */
+#define NDN_IOT_LOG_INIT(name)						\
+  static ::ndn::iot::LogModule& g_logModule = ::ndn::iot::LogModule::get(#name)
+
+#define LOG_AT(level, statement) {					\
+    if (g_logModule.isEnabled(level)) {					\
+      statement;							\
+    }									\
 }
 
-#define LOG_FAILURE(msg, expression)		\
-  std::cerr << "[" << LoggerTimestamp{} << "] " << "[" << msg << "]: " << expression << std::endl; \
-  LOG_DOT_LINE
-  
-#define LOG_INFO(expression) \
-  std::cerr << "[" << LoggerTimestamp{} << "] " << expression << std::endl; \
-  LOG_DOT_LINE
+#define LOG_WELCOME(role, name)						\
+  LOG_RECORD("##########################################################\n" \
+	     << "# THE [" << role << "] NAMED [" << name << "] IS RUNNING " \
+	     << "\n##########################################################\n")
+
+#define LOG_BYEBYE(name, msg)						\
+  LOG_RECORD("+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n" \
+	     << "+ [" << name << "] IS GOING TO BE TERMINATED " << msg	\
+	     << "\n+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n")
+
+#if NDN_IOT_LOG_MAX_LEVEL >= NDN_IOT_LOG_ERROR
+#define LOG_FAILURE(msg, expression)					\
+  LOG_AT(NDN_IOT_LOG_ERROR,						\
+	 LOG_RECORD("[" << LoggerTimestamp{} << "] " << "[" << msg << "]: " << expression \
+		    << "\n" << LOG_DOT_LINE_TEXT))
+#else
+#define LOG_FAILURE(msg, expression) {}
+#endif
+
+#if NDN_IOT_LOG_MAX_LEVEL >= NDN_IOT_LOG_INFO
+#define LOG_STEP(idx, msg)						\
+  LOG_AT(NDN_IOT_LOG_INFO,						\
+	 LOG_RECORD(LOG_DOT_LINE_TEXT					\
+		    << "- [STEP " << idx << "]: " << msg << "\n"		\
+		    << LOG_DOT_LINE_TEXT))
+
+#define LOG_INFO(expression)						\
+  LOG_AT(NDN_IOT_LOG_INFO,						\
+	 LOG_RECORD("[" << LoggerTimestamp{} << "] " << expression << "\n" << LOG_DOT_LINE_TEXT))
+#else
+#define LOG_STEP(idx, msg) {}
+#define LOG_INFO(expression) {}
+#endif
 
 void printInfoFromInterest(const std::string& msg, const Interest& interest);
 void printInfoFromData(const std::string& msg, const Data& data);
-  
-#define LOG_INTEREST(msg, interest) {					\
-    printInfoFromInterest(msg, interest);				\
-    LOG_DOT_LINE							\
-}
-#define LOG_DATA(msg, data) {					\
-    printInfoFromData(msg, data);				\
-    LOG_DOT_LINE						\
-}
 
+// the printers decode names, signatures and parameters, so they only run when enabled
+#if NDN_IOT_LOG_MAX_LEVEL >= NDN_IOT_LOG_TRACE
+#define LOG_INTEREST(msg, interest) LOG_AT(NDN_IOT_LOG_TRACE, printInfoFromInterest(msg, interest))
+#define LOG_DATA(msg, data) LOG_AT(NDN_IOT_LOG_TRACE, printInfoFromData(msg, data))
+#else
+#define LOG_INTEREST(msg, interest) {}
+#define LOG_DATA(msg, data) {}
+#endif
+
+// packets are recorded into the capture with capturePacket(), see packet-capture.hpp
 #define LOG_INTEREST_IN(interest)  LOG_INTEREST("Interest  IN", interest)
 #define LOG_INTEREST_OUT(interest) LOG_INTEREST("Interest OUT", interest)
 #define LOG_DATA_IN(data)  LOG_DATA("    Data  IN", data)
 #define LOG_DATA_OUT(data) LOG_DATA("    Data OUT", data)
 
-//#define DEBUG
-#ifdef DEBUG
-#define LOG_DBG LOG_INFO
+#if NDN_IOT_LOG_MAX_LEVEL >= NDN_IOT_LOG_DEBUG
+#define LOG_DBG(expression)						\
+  LOG_AT(NDN_IOT_LOG_DEBUG,						\
+	 LOG_RECORD("[" << LoggerTimestamp{} << "] " << expression << "\n" << LOG_DOT_LINE_TEXT))
 #else
 #define LOG_DBG(expression) {}
 #endif
@@ -0,0 +1,117 @@
+#include "loop-monitor.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+
+namespace ndn {
+namespace iot {
+
+NDN_IOT_LOG_INIT(loop);
+
+LoopMonitor::LoopMonitor(Scheduler& scheduler, const LoopMonitorOptions& options)
+  : m_scheduler(scheduler)
+  , m_options(options)
+  , m_nStalls(0)
+{
+}
+
+void
+LoopMonitor::start()
+{
+  if (m_options.probeInterval > time::milliseconds::zero()) {
+    scheduleProbe();
+  }
+  if (m_options.reportMode == LoopMonitorOptions::REPORT_PERIODIC) {
+    scheduleReport();
+  }
+}
+
+void
+LoopMonitor::scheduleProbe()
+{
+  m_probeDue = time::steady_clock::now() + m_options.probeInterval;
+  m_scheduler.scheduleEvent(m_options.probeInterval, bind(&LoopMonitor::onProbe, this));
+}
+
+void
+LoopMonitor::onProbe()
+{
+  auto lag = std::max(time::steady_clock::now() - m_probeDue, time::nanoseconds::zero());
+  auto lagUs = time::duration_cast<time::microseconds>(lag);
+  m_lag.record(lagUs.count());
+  Metrics::recordTime(Metrics::LOOP_LAG, lag);
+
+  if (lag > m_options.lagThreshold) {
+    ++m_nStalls;
+    LOG_FAILURE("event loop", "stalled, a due event ran "
+		<< time::duration_cast<time::milliseconds>(lag) << " late");
+  }
+
+  scheduleProbe();
+}
+
+void
+LoopMonitor::scheduleReport()
+{
+  m_scheduler.scheduleEvent(m_options.reportInterval, [this] {
+      report();
+      scheduleReport();
+    });
+}
+
+void
+LoopMonitor::afterCallback(const char* name, time::nanoseconds duration)
+{
+  m_callbackTime.record(time::duration_cast<time::microseconds>(duration).count());
+  Metrics::recordTime(Metrics::CALLBACK_TIME, duration);
+
+  if (duration <= m_options.callbackThreshold) {
+    return;
+  }
+
+  ++m_nStalls;
+  LOG_FAILURE("event loop", name << " blocked the loop for "
+	      << time::duration_cast<time::milliseconds>(duration));
+
+  if (m_options.nSlowest == 0) {
+    return;
+  }
+
+  // keep the slowest ones in descending order
+  auto byDuration = [] (const SlowCallback& a, const SlowCallback& b) {
+    return a.duration > b.duration;
+  };
+  SlowCallback slow{name, duration, time::system_clock::now()};
+  if (m_slowest.size() == m_options.nSlowest) {
+    if (!byDuration(slow, m_slowest.back())) {
+      return;
+    }
+    m_slowest.pop_back();
+  }
+  m_slowest.insert(std::upper_bound(m_slowest.begin(), m_slowest.end(), slow, byDuration),
+		   slow);
+}
+
+void
+LoopMonitor::report()
+{
+  if (m_options.reportMode == LoopMonitorOptions::REPORT_NONE) {
+    return;
+  }
+
+  LOG_INFO("event loop: " << m_nStalls << " stalls, lag (us) " << m_lag
+	   << ", callbacks (us) " << m_callbackTime);
+  for (const auto& slow : m_slowest) {
+    LOG_INFO("  " << time::duration_cast<time::microseconds>(slow.duration) << " "
+	     << slow.name << " at " << time::toIsoString(slow.when));
+  }
+
+  m_lag.reset();
+  m_callbackTime.reset();
+  m_slowest.clear();
+  m_nStalls = 0;
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,153 @@
+#ifndef NDN_IOT_LOOP_MONITOR_HPP
+#define NDN_IOT_LOOP_MONITOR_HPP
+
+#include "histogram.hpp"
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+struct LoopMonitorOptions
+{
+  enum ReportMode {
+    REPORT_NONE,
+    REPORT_PERIODIC,
+    REPORT_ON_EXIT
+  };
+
+  /** @brief how often to probe the scheduling lag of the event loop, zero to disable
+   */
+  time::milliseconds probeInterval = time::milliseconds(100);
+
+  /** @brief log a stall when a probe fires later than this
+   */
+  time::milliseconds lagThreshold = time::milliseconds(50);
+
+  /** @brief log a stall and remember the callback when it runs longer than this
+   */
+  time::milliseconds callbackThreshold = time::milliseconds(20);
+
+  /** @brief how many of the slowest callbacks a report lists
+   */
+  size_t nSlowest = 10;
+
+  ReportMode reportMode = REPORT_ON_EXIT;
+
+  time::seconds reportInterval = time::seconds(60);
+};
+
+/** @brief Watch an event loop for stalls
+ *
+ *  A probe timer measures how late the loop runs a due event, which catches any
+ *  blocking call; callbacks wrapped with wrap() are timed individually and the slowest
+ *  since the last report are kept with their names.
+ */
+class LoopMonitor
+{
+public:
+  LoopMonitor(Scheduler& scheduler, const LoopMonitorOptions& options);
+
+  void
+  start();
+
+  void
+  report();
+
+public:
+  /** @brief time the scope of a callback
+   */
+  class Scope
+  {
+  public:
+    Scope(LoopMonitor& monitor, const char* name)
+      : m_monitor(monitor)
+      , m_name(name)
+      , m_start(time::steady_clock::now())
+    {
+    }
+
+    ~Scope()
+    {
+      m_monitor.afterCallback(m_name, time::steady_clock::now() - m_start);
+    }
+
+  private:
+    LoopMonitor& m_monitor;
+    const char* m_name;
+    time::steady_clock::TimePoint m_start;
+  };
+
+  template<typename Callback>
+  class Monitored
+  {
+  public:
+    Monitored(LoopMonitor& monitor, const char* name, Callback callback)
+      : m_monitor(&monitor)
+      , m_name(name)
+      , m_callback(std::move(callback))
+    {
+    }
+
+    template<typename... Args>
+    void
+    operator()(Args&&... args) const
+    {
+      Scope scope(*m_monitor, m_name);
+      m_callback(std::forward<Args>(args)...);
+    }
+
+  private:
+    LoopMonitor* m_monitor;
+    const char* m_name;
+    Callback m_callback;
+  };
+
+  /** @brief wrap a callback to be timed under @p name, which must outlive the callback
+   */
+  template<typename Callback>
+  Monitored<Callback>
+  wrap(const char* name, Callback callback)
+  {
+    return Monitored<Callback>(*this, name, std::move(callback));
+  }
+
+private:
+  void
+  scheduleProbe();
+
+  void
+  onProbe();
+
+  void
+  scheduleReport();
+
+  void
+  afterCallback(const char* name, time::nanoseconds duration);
+
+private:
+  struct SlowCallback
+  {
+    std::string name;
+    time::nanoseconds duration;
+    time::system_clock::TimePoint when;
+  };
+
+  Scheduler& m_scheduler;
+  LoopMonitorOptions m_options;
+
+  time::steady_clock::TimePoint m_probeDue;
+  Histogram m_lag;
+  Histogram m_callbackTime;
+  std::vector<SlowCallback> m_slowest;
+  size_t m_nStalls;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_LOOP_MONITOR_HPP
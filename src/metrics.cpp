@@ -0,0 +1,189 @@
+#include "metrics.hpp"
+#include "control-parameters.hpp"
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace ndn {
+namespace iot {
+
+namespace {
+
+struct ThreadMetrics
+{
+  ThreadMetrics()
+  {
+    for (auto& counter : counters) {
+      counter = 0;
+    }
+  }
+
+  std::array<std::atomic<uint64_t>, Metrics::N_COUNTERS> counters;
+  std::mutex mutex;
+  std::array<Histogram, Metrics::N_DISTRIBUTIONS> distributions;
+};
+
+struct MetricsRegistry
+{
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadMetrics>> threads;
+};
+
+MetricsRegistry&
+getRegistry()
+{
+  static MetricsRegistry registry;
+  return registry;
+}
+
+ThreadMetrics&
+getThreadMetrics()
+{
+  // the registry keeps the slot of an exited thread, so its numbers are not lost
+  thread_local std::shared_ptr<ThreadMetrics> metrics;
+  if (metrics == nullptr) {
+    metrics = std::make_shared<ThreadMetrics>();
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(metrics);
+  }
+  return *metrics;
+}
+
+const char* SECURITY_TYPES[] = {"none", "identity", "hmac", "hmac+identity"};
+
+} // namespace
+
+void
+Metrics::increment(Counter counter, uint64_t delta)
+{
+  getThreadMetrics().counters[counter].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void
+Metrics::record(Distribution distribution, uint64_t value)
+{
+  auto& metrics = getThreadMetrics();
+  std::lock_guard<std::mutex> lock(metrics.mutex);
+  metrics.distributions[distribution].record(value);
+}
+
+Metrics::Snapshot
+Metrics::snapshot()
+{
+  Snapshot snapshot;
+  snapshot.counters.fill(0);
+
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto& metrics : registry.threads) {
+    for (size_t i = 0; i < N_COUNTERS; ++i) {
+      snapshot.counters[i] += metrics->counters[i].load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> threadLock(metrics->mutex);
+    for (size_t i = 0; i < N_DISTRIBUTIONS; ++i) {
+      snapshot.distributions[i].merge(metrics->distributions[i]);
+    }
+  }
+  return snapshot;
+}
+
+std::string
+Metrics::getName(Counter counter)
+{
+  if (counter < COMMAND_VERIFIED) {
+    return std::string("command/received/") + SECURITY_TYPES[counter - COMMAND_RECEIVED];
+  }
+  if (counter < COMMAND_FAILED) {
+    return std::string("command/verified/") + SECURITY_TYPES[counter - COMMAND_VERIFIED];
+  }
+  if (counter < BROADCAST_ROUNDS) {
+    return std::string("command/failed/") + SECURITY_TYPES[counter - COMMAND_FAILED];
+  }
+
+  switch (counter) {
+  case BROADCAST_ROUNDS: return "broadcast/rounds";
+  case BROADCAST_REPLIES: return "broadcast/replies";
+  case INTEREST_EXPRESSED: return "interest/expressed";
+  case INTEREST_AGGREGATED: return "interest/aggregated";
+  case COMMAND_RETRANSMITTED: return "command/retransmitted";
+  case COMMAND_TIMED_OUT: return "command/timed-out";
+  case RESPONSE_CACHE_HIT: return "response-cache/hit";
+  case RESPONSE_CACHE_PENDING: return "response-cache/pending";
+  case RESPONSE_CACHE_MISS: return "response-cache/miss";
+  case PIB_WRITES: return "pib/writes";
+  case FORWARDER_RECONNECTIONS: return "forwarder/reconnections";
+  case FACES_REAPED: return "face/reaped";
+  case FACES_RESTORED: return "face/restored";
+  default: return "unknown";
+  }
+}
+
+std::string
+Metrics::getName(Distribution distribution)
+{
+  switch (distribution) {
+  case HMAC_SIGN_TIME: return "time/hmac-sign";
+  case HMAC_VERIFY_TIME: return "time/hmac-verify";
+  case SIGNATURE_TIME: return "time/signature";
+  case HANDLER_TIME: return "time/handler";
+  case REPLIES_PER_BROADCAST: return "broadcast/replies-per-collection";
+  case LOOP_LAG: return "time/loop-lag";
+  case CALLBACK_TIME: return "time/callback";
+  case COMMAND_RTT: return "time/command-rtt";
+  case COMMAND_TIME: return "time/command";
+  case KEY_GENERATION_TIME: return "time/key-generation";
+  case KEYCHAIN_TIME: return "time/keychain";
+  case PIB_FLUSH_TIME: return "time/pib-flush";
+  case STARTUP_TIME: return "time/startup";
+  case FORWARDER_RECOVERY_TIME: return "time/forwarder-recovery";
+  default: return "unknown";
+  }
+}
+
+std::vector<Block>
+Metrics::encode(const Snapshot& snapshot)
+{
+  std::vector<Block> blocks;
+
+  for (size_t i = 0; i < N_COUNTERS; ++i) {
+    auto metric = makeEmptyBlock(tlv::iot::Metric);
+    metric.push_back(makeStringBlock(tlv::iot::MetricName, getName(static_cast<Counter>(i))));
+    metric.push_back(makeNonNegativeIntegerBlock(tlv::iot::MetricValue, snapshot.counters[i]));
+    metric.encode();
+    blocks.push_back(metric);
+  }
+
+  for (size_t i = 0; i < N_DISTRIBUTIONS; ++i) {
+    const auto& histogram = snapshot.distributions[i];
+    auto metric = makeEmptyBlock(tlv::iot::Metric);
+    metric.push_back(makeStringBlock(tlv::iot::MetricName,
+				     getName(static_cast<Distribution>(i))));
+    metric.push_back(makeNonNegativeIntegerBlock(tlv::iot::MetricValue, histogram.getCount()));
+
+    const auto& buckets = histogram.getBuckets();
+    for (size_t j = 0; j < buckets.size(); ++j) {
+      if (buckets[j] == 0) {
+	continue;
+      }
+      auto bucket = makeEmptyBlock(tlv::iot::MetricBucket);
+      bucket.push_back(makeNonNegativeIntegerBlock(tlv::iot::MetricBucketBound,
+						   Histogram::getBucketValue(j)));
+      bucket.push_back(makeNonNegativeIntegerBlock(tlv::iot::MetricValue, buckets[j]));
+      bucket.encode();
+      metric.push_back(bucket);
+    }
+
+    metric.encode();
+    blocks.push_back(metric);
+  }
+
+  return blocks;
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,132 @@
+#ifndef NDN_IOT_METRICS_HPP
+#define NDN_IOT_METRICS_HPP
+
+#include "histogram.hpp"
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <array>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Process-wide registry of counters and histograms
+ *
+ *  Every thread records into its own slot, so recording is a relaxed atomic add for a
+ *  counter and an uncontended lock for a histogram; slots are only summed up when a
+ *  snapshot is taken, e.g. to answer the /localhost/iot/metrics dataset.
+ */
+class Metrics
+{
+public:
+  /** @brief command counters come in four variants, indexed by the verification option
+   *         (received, failed) or the verification type (verified) of SecurityOptions
+   */
+  enum Counter {
+    COMMAND_RECEIVED = 0,
+    COMMAND_VERIFIED = 4,
+    COMMAND_FAILED = 8,
+    BROADCAST_ROUNDS = 12,
+    BROADCAST_REPLIES,
+    INTEREST_EXPRESSED,
+    INTEREST_AGGREGATED,
+    COMMAND_RETRANSMITTED,
+    COMMAND_TIMED_OUT,
+    RESPONSE_CACHE_HIT,
+    RESPONSE_CACHE_PENDING,
+    RESPONSE_CACHE_MISS,
+    PIB_WRITES,
+    FORWARDER_RECONNECTIONS,
+    FACES_REAPED,
+    FACES_RESTORED,
+    N_COUNTERS
+  };
+
+  enum Distribution {
+    HMAC_SIGN_TIME = 0,
+    HMAC_VERIFY_TIME,
+    SIGNATURE_TIME,
+    HANDLER_TIME,
+    REPLIES_PER_BROADCAST,
+    LOOP_LAG,
+    CALLBACK_TIME,
+    COMMAND_RTT,
+    COMMAND_TIME,
+    KEY_GENERATION_TIME,
+    KEYCHAIN_TIME,
+    PIB_FLUSH_TIME,
+    STARTUP_TIME,
+    FORWARDER_RECOVERY_TIME,
+    N_DISTRIBUTIONS
+  };
+
+  struct Snapshot
+  {
+    std::array<uint64_t, N_COUNTERS> counters;
+    std::array<Histogram, N_DISTRIBUTIONS> distributions;
+  };
+
+  static void
+  increment(Counter counter, uint64_t delta = 1);
+
+  /** @brief count a command with the given SecurityOptions option or type
+   */
+  static void
+  incrementCommand(Counter counter, int securityType)
+  {
+    increment(static_cast<Counter>(counter + (securityType & 0x3)));
+  }
+
+  static void
+  record(Distribution distribution, uint64_t value);
+
+  static void
+  recordTime(Distribution distribution, time::nanoseconds duration)
+  {
+    record(distribution, time::duration_cast<time::microseconds>(duration).count());
+  }
+
+  static Snapshot
+  snapshot();
+
+  static std::string
+  getName(Counter counter);
+
+  static std::string
+  getName(Distribution distribution);
+
+  /** @brief Encode a snapshot as a sequence of Metric blocks
+   */
+  static std::vector<Block>
+  encode(const Snapshot& snapshot);
+
+public:
+  /** @brief record the lifetime of the object into a time distribution, in microseconds
+   */
+  class ScopedTimer
+  {
+  public:
+    explicit
+    ScopedTimer(Distribution distribution)
+      : m_distribution(distribution)
+      , m_start(time::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+      recordTime(m_distribution, time::steady_clock::now() - m_start);
+    }
+
+  private:
+    Distribution m_distribution;
+    time::steady_clock::TimePoint m_start;
+  };
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_METRICS_HPP
@@ -0,0 +1,106 @@
+#include "name-table.hpp"
+
+#include <boost/functional/hash.hpp>
+
+namespace ndn {
+namespace iot {
+
+const NameTable::Id NameTable::ROOT;
+const NameTable::Id NameTable::NONE;
+
+NameTable::NameTable()
+{
+  m_entries.push_back({NONE, name::Component(), 0});
+}
+
+size_t
+NameTable::hashChild(size_t parentHash, const name::Component& component)
+{
+  // the TLV type is part of the wire, so a version and a generic component differ
+  auto hash = parentHash;
+  boost::hash_combine(hash, boost::hash_range(component.wire(),
+					      component.wire() + component.size()));
+  return hash;
+}
+
+NameTable::Id
+NameTable::findChild(Id parent, const name::Component& component, size_t hash) const
+{
+  auto range = m_ids.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto& entry = m_entries[it->second];
+    if (entry.parent == parent && entry.component == component) {
+      return it->second;
+    }
+  }
+  return NONE;
+}
+
+bool
+NameTable::isEntryOf(Id id, const Name& name) const
+{
+  for (size_t i = name.size(); i > 0; --i, id = m_entries[id].parent) {
+    if (id == ROOT || m_entries[id].component != name[i - 1]) {
+      return false;
+    }
+  }
+  return id == ROOT;
+}
+
+NameTable::Id
+NameTable::intern(const Name& name)
+{
+  Id id = ROOT;
+  for (const auto& component : name) {
+    auto hash = hashChild(m_entries[id].hash, component);
+    auto child = findChild(id, component, hash);
+    if (child == NONE) {
+      // a copy of its own, not a view into the whole packet the name was decoded from
+      child = static_cast<Id>(m_entries.size());
+      m_entries.push_back({id, name::Component(Block(component.wire(), component.size())),
+			   hash});
+      m_ids.emplace(hash, child);
+    }
+    id = child;
+  }
+  return id;
+}
+
+NameTable::Id
+NameTable::find(const Name& name) const
+{
+  // the hash of a name does not depend on which of its prefixes are interned
+  size_t hash = m_entries[ROOT].hash;
+  for (const auto& component : name) {
+    hash = hashChild(hash, component);
+  }
+  if (name.empty()) {
+    return ROOT;
+  }
+
+  auto range = m_ids.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (isEntryOf(it->second, name)) {
+      return it->second;
+    }
+  }
+  return NONE;
+}
+
+Name
+NameTable::getName(Id id) const
+{
+  std::vector<const name::Component*> components;
+  for (; id != ROOT; id = m_entries[id].parent) {
+    components.push_back(&m_entries[id].component);
+  }
+
+  Name name;
+  for (auto it = components.rbegin(); it != components.rend(); ++it) {
+    name.append(**it);
+  }
+  return name;
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,98 @@
+#ifndef NDN_IOT_NAME_TABLE_HPP
+#define NDN_IOT_NAME_TABLE_HPP
+
+#include <ndn-cxx/name.hpp>
+
+#include <deque>
+#include <limits>
+#include <unordered_map>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Interned names, each with a stable integer ID and a precomputed hash
+ *
+ *  A name is stored as one entry per prefix, an ID of its parent and its last component,
+ *  so the components shared by many names (/iot/shannon/as/...) are not copied per name,
+ *  though every entry costs its own component buffer and index node.  A map keyed by
+ *  NameTable::Id hashes an integer once the ID is known; getting the ID of a name from
+ *  the network with find() still hashes every byte of it, as a map keyed by Name would,
+ *  and then probes the index once.  So keep the ID of a name looked up repeatedly.  An
+ *  ID stays valid as long as the table: names are never removed, so look names up with
+ *  find() and only intern() those to be kept.
+ */
+class NameTable : noncopyable
+{
+public:
+  typedef uint32_t Id;
+
+  /** @brief the ID of the empty name
+   */
+  static const Id ROOT = 0;
+
+  /** @brief the ID of no name, returned by find() for a name never interned
+   */
+  static const Id NONE = std::numeric_limits<Id>::max();
+
+  NameTable();
+
+  /** @return the ID of @p name, interned if needed
+   */
+  Id
+  intern(const Name& name);
+
+  /** @return the ID of @p name, or NONE if it was never interned
+   *  @note one hash of the whole name and one probe, whatever its number of components
+   */
+  Id
+  find(const Name& name) const;
+
+  Name
+  getName(Id id) const;
+
+  /** @return the hash of the name of @p id, computed when it was interned
+   */
+  size_t
+  getHash(Id id) const
+  {
+    return m_entries[id].hash;
+  }
+
+  /** @return the number of interned names, prefixes included
+   */
+  size_t
+  size() const
+  {
+    return m_entries.size();
+  }
+
+private:
+  struct Entry
+  {
+    Id parent;
+    name::Component component;
+    size_t hash;
+  };
+
+  static size_t
+  hashChild(size_t parentHash, const name::Component& component);
+
+  /** @return the child of @p parent with @p component, NONE if there is none
+   */
+  Id
+  findChild(Id parent, const name::Component& component, size_t hash) const;
+
+  /** @return whether @p id is the entry of @p name
+   */
+  bool
+  isEntryOf(Id id, const Name& name) const;
+
+private:
+  std::deque<Entry> m_entries; // by ID
+  std::unordered_multimap<size_t, Id> m_ids; // by the hash of the whole name
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_NAME_TABLE_HPP
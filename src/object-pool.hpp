@@ -0,0 +1,128 @@
+#ifndef NDN_IOT_OBJECT_POOL_HPP
+#define NDN_IOT_OBJECT_POOL_HPP
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Recycled objects, referred to by handles that go stale on release
+ *
+ *  An object is not destroyed on release but cleared through T::clear() and handed
+ *  out again, so whatever storage it grew (a name, a string) is reused by the next
+ *  acquisition.  A handle is the slot index and the generation of the slot, 8 bytes,
+ *  so a callback capturing it and a pointer stays within the small buffer of
+ *  boost::function and std::function; a callback that runs after its object was
+ *  released or recycled gets nullptr from get().
+ */
+template<typename T>
+class ObjectPool : boost::noncopyable
+{
+public:
+  typedef uint64_t Handle;
+
+  Handle
+  acquire()
+  {
+    if (m_free.empty()) {
+      m_free.push_back(m_slots.size());
+      m_slots.emplace_back(new Slot);
+    }
+    auto index = m_free.back();
+    m_free.pop_back();
+    auto& slot = *m_slots[index];
+    slot.isAcquired = true;
+    ++m_size;
+    return makeHandle(index, slot.generation);
+  }
+
+  /** @return the object of @p handle, or nullptr if it was released
+   */
+  T*
+  get(Handle handle) const
+  {
+    auto index = static_cast<size_t>(handle & 0xFFFFFFFF);
+    if (index >= m_slots.size()) {
+      return nullptr;
+    }
+    auto& slot = *m_slots[index];
+    if (!slot.isAcquired || slot.generation != (handle >> 32)) {
+      return nullptr;
+    }
+    return &slot.object;
+  }
+
+  /** @brief clear and recycle the object of @p handle, nothing if it was released
+   */
+  void
+  release(Handle handle)
+  {
+    if (get(handle) != nullptr) {
+      releaseSlot(static_cast<uint32_t>(handle & 0xFFFFFFFF));
+    }
+  }
+
+  /** @brief release every acquired object for which @p predicate returns true
+   *  @return the number of objects released
+   */
+  template<typename Predicate>
+  size_t
+  releaseIf(Predicate predicate)
+  {
+    size_t nReleased = 0;
+    for (uint32_t index = 0; index < m_slots.size(); ++index) {
+      if (m_slots[index]->isAcquired && predicate(m_slots[index]->object)) {
+	releaseSlot(index);
+	++nReleased;
+      }
+    }
+    return nReleased;
+  }
+
+  /** @return the number of acquired objects
+   */
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+private:
+  struct Slot
+  {
+    T object;
+    uint32_t generation = 1;
+    bool isAcquired = false;
+  };
+
+  static Handle
+  makeHandle(uint32_t index, uint32_t generation)
+  {
+    return (static_cast<Handle>(generation) << 32) | index;
+  }
+
+  void
+  releaseSlot(uint32_t index)
+  {
+    auto& slot = *m_slots[index];
+    slot.object.clear();
+    slot.isAcquired = false;
+    ++slot.generation;
+    m_free.push_back(index);
+    --m_size;
+  }
+
+private:
+  std::vector<std::unique_ptr<Slot>> m_slots;
+  std::vector<uint32_t> m_free;
+  size_t m_size = 0;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_OBJECT_POOL_HPP
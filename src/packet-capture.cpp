@@ -0,0 +1,267 @@
+#include "packet-capture.hpp"
+
+#include <ndn-cxx/util/time.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <dirent.h>
+
+namespace ndn {
+namespace iot {
+namespace capture {
+
+static const size_t MAX_BUFFER_SIZE = 256 * 1024;
+
+static uint64_t
+now()
+{
+  return time::duration_cast<time::microseconds>(
+    time::system_clock::now().time_since_epoch()).count();
+}
+
+template<typename T>
+static void
+putLittleEndian(std::vector<uint8_t>& buffer, T value)
+{
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+Writer::Writer(const std::string& path, size_t maxSegmentSize, size_t indexInterval,
+	       size_t maxSegments)
+  : m_path(path)
+  , m_maxSegmentSize(maxSegmentSize)
+  , m_indexInterval(indexInterval)
+  , m_maxSegments(maxSegments)
+  , m_segment(0)
+  , m_nWritten(0)
+  , m_lastIndexOffset(0)
+{
+  m_buffer.reserve(MAX_BUFFER_SIZE);
+  removeOldSegments();
+  openSegment();
+}
+
+Writer::~Writer()
+{
+  close();
+}
+
+void
+Writer::append(const Block& packet, Direction direction, const std::string& entity)
+{
+  if (!isOpen()) {
+    return;
+  }
+
+  if (getOffset() + RECORD_HEADER_SIZE + packet.size() > m_maxSegmentSize) {
+    closeSegment();
+    ++m_segment;
+    openSegment();
+    if (m_maxSegments > 0 && m_segment >= m_maxSegments) {
+      std::remove(getSegmentPath(m_segment - m_maxSegments).data());
+    }
+  }
+
+  uint16_t tag = getTag(entity);
+  uint64_t timestamp = now();
+  m_pendingIndex.push_back({timestamp, getOffset()});
+  appendRecord(RECORD_PACKET, direction, tag, timestamp, packet.wire(), packet.size());
+
+  if (m_pendingIndex.size() >= m_indexInterval) {
+    appendIndex();
+    flush();
+  }
+  else if (m_buffer.size() >= MAX_BUFFER_SIZE) {
+    flush();
+  }
+}
+
+void
+Writer::flush()
+{
+  if (!isOpen() || m_buffer.empty()) {
+    return;
+  }
+
+  m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+  m_file.flush();
+  m_nWritten += m_buffer.size();
+  m_buffer.clear();
+}
+
+void
+Writer::close()
+{
+  if (isOpen()) {
+    closeSegment();
+  }
+}
+
+std::string
+Writer::getSegmentPath(uint32_t segment) const
+{
+  if (segment == 0) {
+    return m_path;
+  }
+  return m_path + "." + std::to_string(segment);
+}
+
+void
+Writer::removeOldSegments() const
+{
+  auto slash = m_path.rfind('/');
+  auto directory = slash == std::string::npos ? "." : m_path.substr(0, slash + 1);
+  auto prefix = (slash == std::string::npos ? m_path : m_path.substr(slash + 1)) + ".";
+
+  DIR* dir = ::opendir(directory.data());
+  if (dir == nullptr) {
+    return;
+  }
+  std::vector<std::string> segments;
+  while (const dirent* entry = ::readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+	name.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+      segments.push_back(m_path + "." + name.substr(prefix.size()));
+    }
+  }
+  ::closedir(dir);
+
+  for (const auto& segment : segments) {
+    std::remove(segment.data());
+  }
+}
+
+void
+Writer::openSegment()
+{
+  m_file.open(getSegmentPath(m_segment), std::ios::out | std::ios::binary | std::ios::trunc);
+  m_nWritten = 0;
+  m_lastIndexOffset = 0;
+  m_tags.clear();
+  m_pendingIndex.clear();
+
+  m_buffer.insert(m_buffer.end(), FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+  putLittleEndian<uint16_t>(m_buffer, FORMAT_VERSION);
+  putLittleEndian<uint16_t>(m_buffer, FILE_HEADER_SIZE);
+  putLittleEndian<uint32_t>(m_buffer, m_segment);
+  putLittleEndian<uint64_t>(m_buffer, now());
+  putLittleEndian<uint64_t>(m_buffer, 0);
+}
+
+void
+Writer::closeSegment()
+{
+  appendIndex();
+
+  m_buffer.insert(m_buffer.end(), TRAILER_MAGIC, TRAILER_MAGIC + sizeof(TRAILER_MAGIC));
+  putLittleEndian<uint64_t>(m_buffer, m_lastIndexOffset);
+
+  flush();
+  m_file.close();
+}
+
+uint16_t
+Writer::getTag(const std::string& entity)
+{
+  auto it = m_tags.find(entity);
+  if (it != m_tags.end()) {
+    return it->second;
+  }
+
+  uint16_t tag = m_tags.size();
+  m_tags[entity] = tag;
+
+  std::vector<uint8_t> payload;
+  putLittleEndian<uint16_t>(payload, tag);
+  payload.insert(payload.end(), entity.begin(), entity.end());
+  appendRecord(RECORD_TAG, INCOMING, tag, now(), payload.data(), payload.size());
+  return tag;
+}
+
+void
+Writer::appendRecord(RecordType type, Direction direction, uint16_t tag, uint64_t timestamp,
+		     const uint8_t* payload, size_t length)
+{
+  m_buffer.push_back(type);
+  m_buffer.push_back(direction);
+  putLittleEndian<uint16_t>(m_buffer, tag);
+  putLittleEndian<uint32_t>(m_buffer, length);
+  putLittleEndian<uint64_t>(m_buffer, timestamp);
+  m_buffer.insert(m_buffer.end(), payload, payload + length);
+}
+
+void
+Writer::appendIndex()
+{
+  if (m_pendingIndex.empty()) {
+    return;
+  }
+
+  std::vector<uint8_t> payload;
+  payload.reserve(12 + m_pendingIndex.size() * sizeof(IndexEntry));
+  putLittleEndian<uint64_t>(payload, m_lastIndexOffset);
+  putLittleEndian<uint32_t>(payload, m_pendingIndex.size());
+  for (const auto& entry : m_pendingIndex) {
+    putLittleEndian<uint64_t>(payload, entry.timestamp);
+    putLittleEndian<uint64_t>(payload, entry.offset);
+  }
+  putLittleEndian<uint16_t>(payload, m_tags.size());
+  for (const auto& tag : m_tags) {
+    putLittleEndian<uint16_t>(payload, tag.second);
+    putLittleEndian<uint16_t>(payload, tag.first.size());
+    payload.insert(payload.end(), tag.first.begin(), tag.first.end());
+  }
+
+  m_lastIndexOffset = getOffset();
+  appendRecord(RECORD_INDEX, INCOMING, 0, now(), payload.data(), payload.size());
+  m_pendingIndex.clear();
+}
+
+} // namespace capture
+
+static std::unique_ptr<capture::Writer> globalPacketCapture;
+static std::string globalCaptureEntity;
+
+void
+openPacketCapture(const std::string& path, const std::string& entity, size_t maxSegments)
+{
+  if (globalPacketCapture == nullptr) {
+    globalPacketCapture.reset(new capture::Writer(path, 64 * 1024 * 1024, 1024, maxSegments));
+  }
+  globalCaptureEntity = entity;
+}
+
+bool
+isPacketCaptureOpen()
+{
+  return globalPacketCapture != nullptr;
+}
+
+void
+writeToFile(const Block& block, capture::Direction direction)
+{
+  if (globalPacketCapture != nullptr) {
+    globalPacketCapture->append(block, direction, globalCaptureEntity);
+  }
+}
+
+void
+flushPacketCapture()
+{
+  if (globalPacketCapture != nullptr) {
+    globalPacketCapture->flush();
+  }
+}
+
+void
+closePacketCapture()
+{
+  globalPacketCapture.reset();
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,176 @@
+#ifndef NDN_IOT_PACKET_CAPTURE_HPP
+#define NDN_IOT_PACKET_CAPTURE_HPP
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+namespace capture {
+
+/** @brief On-disk layout of packet captures, all integers are little-endian
+ *
+ *  A segment starts with a FileHeader and is a sequence of records, each one a
+ *  RecordHeader followed by @c length bytes of payload:
+ *   - PACKET: the wire encoding of an Interest or Data
+ *   - TAG: u16 tag id followed by the entity name, defined before its first use
+ *   - INDEX: u64 offset of the previous INDEX (0 if none), u32 count, then count pairs of
+ *            u64 timestamp and u64 offset of the PACKET records since the previous INDEX,
+ *            then u16 number of tags and for each of them u16 id, u16 length and the name,
+ *            so a reader that seeks past the TAG records still knows every entity
+ *  A cleanly closed segment ends with a final INDEX and a Trailer pointing to it, so a
+ *  reader can walk the index chain backwards instead of scanning the whole segment.
+ */
+static const char FILE_MAGIC[8] = {'N', 'D', 'N', 'I', 'O', 'T', 'P', 'C'};
+static const char TRAILER_MAGIC[8] = {'N', 'D', 'N', 'I', 'O', 'T', 'I', 'X'};
+static const uint16_t FORMAT_VERSION = 1;
+
+static const size_t FILE_HEADER_SIZE = 32;   // magic, u16 version, u16 header size,
+                                             // u32 segment number, u64 start time, u64 reserved
+static const size_t RECORD_HEADER_SIZE = 16; // u8 type, u8 direction, u16 tag, u32 length,
+                                             // u64 timestamp in microseconds since epoch
+static const size_t TRAILER_SIZE = 16;       // magic, u64 offset of the last INDEX
+
+enum RecordType : uint8_t {
+  RECORD_PACKET = 1,
+  RECORD_INDEX = 2,
+  RECORD_TAG = 3
+};
+
+enum Direction : uint8_t {
+  INCOMING = 0,
+  OUTGOING = 1
+};
+
+struct IndexEntry
+{
+  uint64_t timestamp;
+  uint64_t offset;
+};
+
+/** @brief Buffered writer of capture segments with size-based rotation
+ *
+ *  Records are accumulated in memory and written when the buffer fills, when an index
+ *  block is due, or on flush(), which the entity calls once a second, instead of once
+ *  per packet.  Segments are named <path>, <path>.1, <path>.2, ...; those left at the path
+ *  by an earlier capture are removed on open.  Beyond @p maxSegments of them, the oldest
+ *  is removed as a new one opens, and all are kept if zero.
+ */
+class Writer
+{
+public:
+  explicit
+  Writer(const std::string& path,
+	 size_t maxSegmentSize = 64 * 1024 * 1024,
+	 size_t indexInterval = 1024,
+	 size_t maxSegments = 0);
+
+  ~Writer();
+
+  void
+  append(const Block& packet, Direction direction, const std::string& entity);
+
+  void
+  flush();
+
+  void
+  close();
+
+  bool
+  isOpen() const
+  {
+    return m_file.is_open();
+  }
+
+private:
+  std::string
+  getSegmentPath(uint32_t segment) const;
+
+  /** @brief remove <path>.<n> segments of an earlier capture, which would be read as if
+   *         they belonged to this one
+   */
+  void
+  removeOldSegments() const;
+
+  void
+  openSegment();
+
+  void
+  closeSegment();
+
+  uint16_t
+  getTag(const std::string& entity);
+
+  void
+  appendRecord(RecordType type, Direction direction, uint16_t tag, uint64_t timestamp,
+	       const uint8_t* payload, size_t length);
+
+  void
+  appendIndex();
+
+  uint64_t
+  getOffset() const
+  {
+    return m_nWritten + m_buffer.size();
+  }
+
+private:
+  std::string m_path;
+  size_t m_maxSegmentSize;
+  size_t m_indexInterval;
+  size_t m_maxSegments;
+
+  std::ofstream m_file;
+  uint32_t m_segment;
+  uint64_t m_nWritten;
+  std::vector<uint8_t> m_buffer;
+
+  std::map<std::string, uint16_t> m_tags;
+  std::vector<IndexEntry> m_pendingIndex;
+  uint64_t m_lastIndexOffset;
+};
+
+} // namespace capture
+
+/** @brief Start the process-wide capture, tagging its packets with @p entity
+ */
+void
+openPacketCapture(const std::string& path, const std::string& entity, size_t maxSegments = 0);
+
+bool
+isPacketCaptureOpen();
+
+/** @brief Record a packet into the process-wide capture, if it is open
+ */
+void
+writeToFile(const Block& block, capture::Direction direction);
+
+/** @brief write what the process-wide capture buffered, e.g. from a timer
+ */
+void
+flushPacketCapture();
+
+/** @brief Record an Interest or Data into the process-wide capture, without encoding it
+ *         unless the capture is open
+ */
+template<typename Packet>
+inline void
+capturePacket(const Packet& packet, capture::Direction direction)
+{
+  if (isPacketCaptureOpen()) {
+    writeToFile(packet.wireEncode(), direction);
+  }
+}
+
+void
+closePacketCapture();
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_PACKET_CAPTURE_HPP
@@ -0,0 +1,95 @@
+#include "response-cache.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+
+namespace ndn {
+namespace iot {
+
+ResponseCache::ResponseCache(size_t capacity)
+  : m_capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+ResponseCache::Status
+ResponseCache::lookup(const Name& command, shared_ptr<const Data>& reply)
+{
+  auto it = m_index.find(command);
+  if (it != m_index.end() && it->second->reply == nullptr &&
+      it->second->deadline < time::steady_clock::now()) {
+    // the handler never replied
+    m_entries.erase(it->second);
+    m_index.erase(it);
+    it = m_index.end();
+  }
+  if (it == m_index.end()) {
+    Metrics::increment(Metrics::RESPONSE_CACHE_MISS);
+    return MISS;
+  }
+
+  reply = it->second->reply;
+  if (reply == nullptr) {
+    // not refreshed, an entry in progress goes away by its deadline
+    Metrics::increment(Metrics::RESPONSE_CACHE_PENDING);
+    return PENDING;
+  }
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+  Metrics::increment(Metrics::RESPONSE_CACHE_HIT);
+  return HIT;
+}
+
+bool
+ResponseCache::markPending(const Name& command, const time::steady_clock::TimePoint& deadline)
+{
+  auto it = m_index.find(command);
+  if (it != m_index.end()) {
+    if (it->second->reply != nullptr || it->second->deadline >= time::steady_clock::now()) {
+      return false;
+    }
+    it->second->deadline = deadline;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return true;
+  }
+
+  m_entries.push_front({command, nullptr, deadline});
+  m_index.emplace(command, m_entries.begin());
+  evict();
+  return true;
+}
+
+void
+ResponseCache::insert(const Name& command, const shared_ptr<const Data>& reply)
+{
+  auto it = m_index.find(command);
+  if (it == m_index.end()) {
+    m_entries.push_front({command, reply, time::steady_clock::TimePoint()});
+    m_index.emplace(command, m_entries.begin());
+    return evict();
+  }
+
+  it->second->reply = reply;
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+}
+
+void
+ResponseCache::erase(const Name& command)
+{
+  auto it = m_index.find(command);
+  if (it == m_index.end()) {
+    return;
+  }
+  m_entries.erase(it->second);
+  m_index.erase(it);
+}
+
+void
+ResponseCache::evict()
+{
+  while (m_entries.size() > m_capacity) {
+    m_index.erase(m_entries.back().command);
+    m_entries.pop_back();
+  }
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,83 @@
+#ifndef NDN_IOT_RESPONSE_CACHE_HPP
+#define NDN_IOT_RESPONSE_CACHE_HPP
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <list>
+#include <unordered_map>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Signed replies of the latest commands, by the full name of the command
+ *
+ *  The name of a signed command carries its timestamp, nonce and signature, and a
+ *  retransmission only refreshes the Interest nonce, so a retransmitted command has the
+ *  same name and gets the stored reply back without verification or handler.  A command
+ *  that passed authorization and is still in progress has an entry without reply, so its
+ *  retransmissions are dropped until its deadline.  A command that fails before a reply
+ *  is erased, so a retransmission is handled again.  The least recently used entry is
+ *  evicted beyond the capacity.
+ */
+class ResponseCache : noncopyable
+{
+public:
+  enum Status {
+    MISS,
+    PENDING,
+    HIT
+  };
+
+  explicit
+  ResponseCache(size_t capacity);
+
+  /** @brief look up the reply of @p command; a pending entry past its deadline is a miss
+   *  @param[out] reply the stored reply on a hit
+   */
+  Status
+  lookup(const Name& command, shared_ptr<const Data>& reply);
+
+  /** @brief mark @p command in progress until @p deadline, once it is authorized
+   *  @return false if it is pending or answered already, e.g. a retransmission that was
+   *          verified while the original was
+   */
+  bool
+  markPending(const Name& command, const time::steady_clock::TimePoint& deadline);
+
+  void
+  insert(const Name& command, const shared_ptr<const Data>& reply);
+
+  /** @brief forget @p command, which failed without reply
+   */
+  void
+  erase(const Name& command);
+
+  size_t
+  size() const
+  {
+    return m_entries.size();
+  }
+
+private:
+  struct Entry
+  {
+    Name command;
+    shared_ptr<const Data> reply;
+    time::steady_clock::TimePoint deadline; // of a pending entry
+  };
+  typedef std::list<Entry> EntryList;
+
+  void
+  evict();
+
+private:
+  size_t m_capacity;
+  EntryList m_entries; // most recently used first
+  std::unordered_map<Name, EntryList::iterator> m_index;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_RESPONSE_CACHE_HPP
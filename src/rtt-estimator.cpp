@@ -0,0 +1,66 @@
+#include "rtt-estimator.hpp"
+
+#include <algorithm>
+
+namespace ndn {
+namespace iot {
+
+RttEstimator::RttEstimator(const RttEstimatorOptions& options)
+  : m_options(options)
+{
+}
+
+time::milliseconds
+RttEstimator::getRto(const Name& prefix) const
+{
+  auto it = m_entries.find(prefix);
+  if (it == m_entries.end()) {
+    return m_options.initialRto;
+  }
+  return time::duration_cast<time::milliseconds>(it->second.rto);
+}
+
+void
+RttEstimator::addMeasurement(const Name& prefix, time::nanoseconds rtt)
+{
+  auto it = m_entries.find(prefix);
+  if (it == m_entries.end()) {
+    Entry entry;
+    entry.srtt = rtt;
+    entry.rttvar = rtt / 2;
+    entry.rto = clamp(entry.srtt + 4 * entry.rttvar);
+    m_entries.emplace(prefix, entry);
+    return;
+  }
+
+  // alpha = 1/8, beta = 1/4, K = 4
+  auto& entry = it->second;
+  auto error = entry.srtt > rtt ? entry.srtt - rtt : rtt - entry.srtt;
+  entry.rttvar = (3 * entry.rttvar + error) / 4;
+  entry.srtt = (7 * entry.srtt + rtt) / 8;
+  entry.rto = clamp(entry.srtt + 4 * entry.rttvar);
+}
+
+void
+RttEstimator::backoff(const Name& prefix)
+{
+  auto it = m_entries.find(prefix);
+  if (it == m_entries.end()) {
+    Entry entry;
+    entry.srtt = entry.rttvar = time::nanoseconds::zero();
+    entry.rto = clamp(2 * m_options.initialRto);
+    m_entries.emplace(prefix, entry);
+    return;
+  }
+  it->second.rto = clamp(2 * it->second.rto);
+}
+
+time::nanoseconds
+RttEstimator::clamp(time::nanoseconds rto) const
+{
+  return std::min<time::nanoseconds>(std::max<time::nanoseconds>(rto, m_options.minRto),
+				     m_options.maxRto);
+}
+
+} // namespace iot
+} // namespace ndn
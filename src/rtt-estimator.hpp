@@ -0,0 +1,59 @@
+#ifndef NDN_IOT_RTT_ESTIMATOR_HPP
+#define NDN_IOT_RTT_ESTIMATOR_HPP
+
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <unordered_map>
+
+namespace ndn {
+namespace iot {
+
+struct RttEstimatorOptions
+{
+  time::milliseconds initialRto = time::seconds(1);
+  time::milliseconds minRto = time::milliseconds(200);
+  time::milliseconds maxRto = time::seconds(4);
+};
+
+/** @brief Retransmission timeouts per destination prefix, as in RFC 6298
+ */
+class RttEstimator
+{
+public:
+  explicit
+  RttEstimator(const RttEstimatorOptions& options = RttEstimatorOptions());
+
+  time::milliseconds
+  getRto(const Name& prefix) const;
+
+  /** @brief update SRTT and RTTVAR with a sample, only of an Interest never retransmitted
+   */
+  void
+  addMeasurement(const Name& prefix, time::nanoseconds rtt);
+
+  /** @brief double the RTO of @p prefix after a timeout, until the next measurement
+   */
+  void
+  backoff(const Name& prefix);
+
+private:
+  struct Entry
+  {
+    time::nanoseconds srtt;
+    time::nanoseconds rttvar;
+    time::nanoseconds rto;
+  };
+
+  time::nanoseconds
+  clamp(time::nanoseconds rto) const;
+
+private:
+  RttEstimatorOptions m_options;
+  std::unordered_map<Name, Entry> m_entries;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_RTT_ESTIMATOR_HPP
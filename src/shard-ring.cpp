@@ -0,0 +1,58 @@
+#include "shard-ring.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace ndn {
+namespace iot {
+
+ShardRing::ShardRing(size_t nShards, size_t nVirtualNodes)
+  : m_nShards(nShards)
+{
+  for (size_t shard = 0; shard < nShards; ++shard) {
+    for (size_t node = 0; node < nVirtualNodes; ++node) {
+      auto key = "shard-" + std::to_string(shard) + "-" + std::to_string(node);
+      m_points.emplace_back(hash(reinterpret_cast<const uint8_t*>(key.data()), key.size()),
+			    shard);
+    }
+  }
+  std::sort(m_points.begin(), m_points.end());
+}
+
+size_t
+ShardRing::getShard(const Name& name) const
+{
+  if (m_points.empty()) {
+    return 0;
+  }
+
+  const auto& wire = name.wireEncode();
+  auto point = hash(wire.value(), wire.value_size());
+  auto it = std::lower_bound(m_points.begin(), m_points.end(),
+			     std::make_pair(point, static_cast<size_t>(0)));
+  return it == m_points.end() ? m_points.front().second : it->second;
+}
+
+uint64_t
+ShardRing::hash(const uint8_t* buffer, size_t size)
+{
+  const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+  const uint64_t FNV_PRIME = 1099511628211ULL;
+
+  uint64_t value = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < size; ++i) {
+    value ^= buffer[i];
+    value *= FNV_PRIME;
+  }
+
+  // FNV-1a barely mixes the last bytes into the high bits, which place the points
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+} // namespace iot
+} // namespace ndn
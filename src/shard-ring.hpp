@@ -0,0 +1,42 @@
+#ifndef NDN_IOT_SHARD_RING_HPP
+#define NDN_IOT_SHARD_RING_HPP
+
+#include <ndn-cxx/name.hpp>
+
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Consistent hashing of names onto shards
+ *
+ *  Each shard owns several points on a 64-bit ring, and a name belongs to the shard of
+ *  the first point at or after its hash (FNV-1a, finalized as in MurmurHash3).  Adding
+ *  a shard moves only about 1/N of the names.
+ */
+class ShardRing
+{
+public:
+  ShardRing(size_t nShards, size_t nVirtualNodes = 64);
+
+  size_t
+  getShard(const Name& name) const;
+
+  size_t
+  size() const
+  {
+    return m_nShards;
+  }
+
+  static uint64_t
+  hash(const uint8_t* buffer, size_t size);
+
+private:
+  size_t m_nShards;
+  std::vector<std::pair<uint64_t, size_t>> m_points;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_SHARD_RING_HPP
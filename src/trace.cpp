@@ -0,0 +1,181 @@
+#include "trace.hpp"
+
+#include <ndn-cxx/util/random.hpp>
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unistd.h>
+
+namespace ndn {
+namespace iot {
+namespace trace {
+
+namespace {
+
+// spans written at once unless flushTrace() comes first
+const size_t MAX_BUFFER_SIZE = 64 * 1024;
+const char ARRAY_END[] = "\n]\n";
+
+struct TraceFile
+{
+  std::mutex mutex;
+  std::unique_ptr<std::ofstream> file;
+  std::string buffer;
+  std::ofstream::pos_type end; // of the last event written, before the closing bracket
+  pid_t pid = 0;
+  time::system_clock::TimePoint systemAnchor;
+  time::steady_clock::TimePoint steadyAnchor;
+};
+
+TraceFile&
+getTraceFile()
+{
+  static TraceFile traceFile;
+  return traceFile;
+}
+
+std::string
+escape(const std::string& value)
+{
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+std::string
+makeProcessPath(const std::string& path, pid_t pid)
+{
+  auto suffix = "-" + std::to_string(pid);
+  auto extension = path.rfind('.');
+  auto directory = path.rfind('/');
+  if (extension == std::string::npos ||
+      (directory != std::string::npos && extension < directory)) {
+    return path + suffix;
+  }
+  return path.substr(0, extension) + suffix + path.substr(extension);
+}
+
+// with the mutex held
+void
+writeBuffer(TraceFile& trace)
+{
+  if (trace.file == nullptr || trace.buffer.empty()) {
+    return;
+  }
+
+  // every event is longer than the closing bracket it overwrites
+  trace.file->seekp(trace.end);
+  *trace.file << trace.buffer;
+  trace.end = trace.file->tellp();
+  *trace.file << ARRAY_END << std::flush;
+  trace.buffer.clear();
+}
+
+} // namespace
+
+TraceId
+generateTraceId()
+{
+  return random::generateWord64();
+}
+
+Span::Span(TraceId traceId, const std::string& name)
+  : m_traceId(traceId)
+  , m_name(name)
+  , m_start(time::steady_clock::now())
+  , m_isOpen(true)
+{
+}
+
+Span::~Span()
+{
+  end();
+}
+
+void
+Span::end()
+{
+  if (!m_isOpen) {
+    return;
+  }
+  m_isOpen = false;
+
+  auto finish = time::steady_clock::now();
+  auto& trace = getTraceFile();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  if (trace.file == nullptr) {
+    return;
+  }
+
+  auto start = time::duration_cast<time::microseconds>(
+    (trace.systemAnchor + (m_start - trace.steadyAnchor)).time_since_epoch());
+  auto duration = time::duration_cast<time::microseconds>(finish - m_start);
+
+  std::ostringstream os;
+  os << ",\n{\"name\":\"" << escape(m_name) << "\",\"cat\":\"onboarding\",\"ph\":\"X\""
+     << ",\"ts\":" << start.count() << ",\"dur\":" << duration.count()
+     << ",\"pid\":" << trace.pid << ",\"tid\":" << (m_traceId & 0xffffffff)
+     << ",\"args\":{\"trace\":\"" << std::hex << std::setw(16) << std::setfill('0')
+     << m_traceId << "\"}}";
+
+  trace.buffer += os.str();
+  if (trace.buffer.size() >= MAX_BUFFER_SIZE) {
+    writeBuffer(trace);
+  }
+}
+
+std::string
+openTrace(const std::string& path, const std::string& process)
+{
+  auto& trace = getTraceFile();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+
+  trace.pid = ::getpid();
+  auto processPath = makeProcessPath(path, trace.pid);
+  trace.file.reset(new std::ofstream(processPath, std::ios::out | std::ios::trunc));
+  if (!*trace.file) {
+    trace.file.reset();
+    return "";
+  }
+
+  trace.systemAnchor = time::system_clock::now();
+  trace.steadyAnchor = time::steady_clock::now();
+  trace.end = trace.file->tellp();
+
+  // every later event is prefixed by a comma
+  std::ostringstream os;
+  os << "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << trace.pid
+     << ",\"args\":{\"name\":\"" << escape(process) << "\"}}";
+  trace.buffer = os.str();
+  writeBuffer(trace);
+  return processPath;
+}
+
+void
+flushTrace()
+{
+  auto& trace = getTraceFile();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  writeBuffer(trace);
+}
+
+void
+closeTrace()
+{
+  auto& trace = getTraceFile();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  writeBuffer(trace);
+  trace.file.reset();
+}
+
+} // namespace trace
+} // namespace iot
+} // namespace ndn
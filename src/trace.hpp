@@ -0,0 +1,75 @@
+#ifndef NDN_IOT_TRACE_HPP
+#define NDN_IOT_TRACE_HPP
+
+#include <ndn-cxx/util/time.hpp>
+
+#include <string>
+
+namespace ndn {
+namespace iot {
+namespace trace {
+
+/** @brief Identify all spans of one enrollment, carried in ControlParameters across entities
+ */
+typedef uint64_t TraceId;
+
+TraceId
+generateTraceId();
+
+/** @brief A timed step of an enrollment
+ *
+ *  The duration is measured on the steady clock; the start is anchored to the system
+ *  clock when the trace was opened, so spans of entities on different hosts line up as
+ *  well as their clocks do.  A span still open when destroyed ends there, which marks
+ *  steps whose callbacks were dropped, e.g. on a timeout.
+ */
+class Span
+{
+public:
+  Span(TraceId traceId, const std::string& name);
+
+  ~Span();
+
+  void
+  end();
+
+  TraceId
+  getTraceId() const
+  {
+    return m_traceId;
+  }
+
+private:
+  TraceId m_traceId;
+  std::string m_name;
+  time::steady_clock::TimePoint m_start;
+  bool m_isOpen;
+};
+
+/** @brief Start writing the spans of this process as Chrome trace events
+ *
+ *  The file is @p path with the process ID before its extension, e.g. trace-1234.json,
+ *  so that entities started in the same directory do not overwrite each other.  It is a
+ *  JSON array of complete ("X") events, one track per trace ID.  Spans are buffered and
+ *  written in batches by flushTrace(), and the array is closed after every batch, so a
+ *  process that crashes leaves a valid file without its last batch; the files of several
+ *  processes merge with <tt>jq -s add trace-*.json</tt>.
+ *
+ *  @return the path of the file, empty if it cannot be opened
+ */
+std::string
+openTrace(const std::string& path, const std::string& process);
+
+/** @brief write the buffered spans, e.g. from a timer
+ */
+void
+flushTrace();
+
+void
+closeTrace();
+
+} // namespace trace
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_TRACE_HPP
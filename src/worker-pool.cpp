@@ -0,0 +1,48 @@
+#include "worker-pool.hpp"
+
+namespace ndn {
+namespace iot {
+
+WorkerPool::WorkerPool(boost::asio::io_service& mainService, size_t nThreads, size_t nStrands)
+  : m_mainService(mainService)
+{
+  if (nThreads == 0) {
+    return;
+  }
+
+  m_work.reset(new boost::asio::io_service::work(m_ioService));
+  for (size_t i = 0; i < nStrands; ++i) {
+    m_strands.emplace_back(new boost::asio::io_service::strand(m_ioService));
+  }
+  for (size_t i = 0; i < nThreads; ++i) {
+    m_threads.emplace_back([this] { m_ioService.run(); });
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  m_work.reset();
+  m_ioService.stop();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void
+WorkerPool::post(size_t key, const Work& work, const Work& then)
+{
+  if (!isEnabled()) {
+    work();
+    then();
+    return;
+  }
+
+  auto& mainService = m_mainService;
+  m_strands[key % m_strands.size()]->post([work, then, &mainService] {
+      work();
+      mainService.post(then);
+    });
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,58 @@
+#ifndef NDN_IOT_WORKER_POOL_HPP
+#define NDN_IOT_WORKER_POOL_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief Threads for the CPU work of an Entity, e.g. HMAC signing and verification
+ *
+ *  The Face, KeyChain and Scheduler of ndn-cxx are not thread-safe, so the io_service
+ *  they run on stays single-threaded: work posted here must be self-contained, and its
+ *  continuation is posted back to that io_service.  Work of the same key, e.g. of one
+ *  requester, is serialized through a strand and finishes in order.  Only that work runs
+ *  here; the rest of each request still takes the thread of the Face.
+ */
+class WorkerPool : boost::noncopyable
+{
+public:
+  typedef std::function<void()> Work;
+
+  /** @param nThreads the number of threads, work runs inline when zero
+   */
+  WorkerPool(boost::asio::io_service& mainService, size_t nThreads, size_t nStrands = 64);
+
+  ~WorkerPool();
+
+  bool
+  isEnabled() const
+  {
+    return !m_threads.empty();
+  }
+
+  /** @brief run @p work on a worker in the strand of @p key, then @p then on the main
+   *         io_service
+   */
+  void
+  post(size_t key, const Work& work, const Work& then);
+
+private:
+  boost::asio::io_service& m_mainService;
+  boost::asio::io_service m_ioService;
+  std::unique_ptr<boost::asio::io_service::work> m_work;
+  std::vector<std::unique_ptr<boost::asio::io_service::strand>> m_strands;
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_WORKER_POOL_HPP
@@ -0,0 +1,279 @@
+#include "write-behind-pib.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+#include <ndn-cxx/security/key-chain.hpp>
+
+namespace ndn {
+namespace iot {
+
+NDN_IOT_LOG_INIT(pib);
+
+NDN_CXX_V2_KEYCHAIN_REGISTER_PIB_BACKEND(WriteBehindPib);
+
+const time::milliseconds WriteBehindPib::FLUSH_INTERVAL = time::seconds(1);
+
+WriteBehindPib::WriteBehindPib(const std::string& location)
+  : m_sqlite(location)
+  , m_isStopped(false)
+{
+  load();
+  m_thread = std::thread(&WriteBehindPib::flushPeriodically, this);
+}
+
+WriteBehindPib::~WriteBehindPib()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopped = true;
+  }
+  m_stop.notify_one();
+  m_thread.join();
+  flush();
+}
+
+const std::string&
+WriteBehindPib::getScheme()
+{
+  static std::string scheme = "pib-write-behind";
+  return scheme;
+}
+
+void
+WriteBehindPib::load()
+{
+  Metrics::ScopedTimer timer(Metrics::KEYCHAIN_TIME);
+  m_memory.setTpmLocator(m_sqlite.getTpmLocator());
+
+  for (const auto& identity : m_sqlite.getIdentities()) {
+    m_memory.addIdentity(identity);
+    for (const auto& keyName : m_sqlite.getKeysOfIdentity(identity)) {
+      auto bits = m_sqlite.getKeyBits(keyName);
+      m_memory.addKey(identity, keyName, bits.data(), bits.size());
+      for (const auto& certName : m_sqlite.getCertificatesOfKey(keyName)) {
+	m_memory.addCertificate(m_sqlite.getCertificate(certName));
+      }
+      try {
+	m_memory.setDefaultCertificateOfKey(keyName,
+					    m_sqlite.getDefaultCertificateOfKey(keyName).getName());
+      }
+      catch (const security::Pib::Error&) {
+      }
+    }
+    try {
+      m_memory.setDefaultKeyOfIdentity(identity, m_sqlite.getDefaultKeyOfIdentity(identity));
+    }
+    catch (const security::Pib::Error&) {
+    }
+  }
+
+  try {
+    m_memory.setDefaultIdentity(m_sqlite.getDefaultIdentity());
+  }
+  catch (const security::Pib::Error&) {
+  }
+}
+
+void
+WriteBehindPib::writeBehind(const Write& write)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_writes.push_back(write);
+}
+
+void
+WriteBehindPib::flushPeriodically()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_isStopped) {
+    m_stop.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL.count()));
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+void
+WriteBehindPib::flush()
+{
+  std::vector<Write> writes;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    writes.swap(m_writes);
+  }
+  if (writes.empty()) {
+    return;
+  }
+
+  Metrics::ScopedTimer timer(Metrics::PIB_FLUSH_TIME);
+  for (const auto& write : writes) {
+    try {
+      write(m_sqlite);
+    }
+    catch (const std::exception& e) {
+      LOG_FAILURE("pib", "can not write behind: " << e.what());
+    }
+  }
+  Metrics::increment(Metrics::PIB_WRITES, writes.size());
+  LOG_DBG(writes.size() << " PIB updates written");
+}
+
+void
+WriteBehindPib::setTpmLocator(const std::string& tpmLocator)
+{
+  m_memory.setTpmLocator(tpmLocator);
+  writeBehind([tpmLocator] (PibImpl& pib) { pib.setTpmLocator(tpmLocator); });
+}
+
+std::string
+WriteBehindPib::getTpmLocator() const
+{
+  return m_memory.getTpmLocator();
+}
+
+bool
+WriteBehindPib::hasIdentity(const Name& identity) const
+{
+  return m_memory.hasIdentity(identity);
+}
+
+void
+WriteBehindPib::addIdentity(const Name& identity)
+{
+  m_memory.addIdentity(identity);
+  writeBehind([identity] (PibImpl& pib) { pib.addIdentity(identity); });
+}
+
+void
+WriteBehindPib::removeIdentity(const Name& identity)
+{
+  m_memory.removeIdentity(identity);
+  writeBehind([identity] (PibImpl& pib) { pib.removeIdentity(identity); });
+}
+
+void
+WriteBehindPib::clearIdentities()
+{
+  m_memory.clearIdentities();
+  writeBehind([] (PibImpl& pib) { pib.clearIdentities(); });
+}
+
+std::set<Name>
+WriteBehindPib::getIdentities() const
+{
+  return m_memory.getIdentities();
+}
+
+void
+WriteBehindPib::setDefaultIdentity(const Name& identityName)
+{
+  m_memory.setDefaultIdentity(identityName);
+  writeBehind([identityName] (PibImpl& pib) { pib.setDefaultIdentity(identityName); });
+}
+
+Name
+WriteBehindPib::getDefaultIdentity() const
+{
+  return m_memory.getDefaultIdentity();
+}
+
+bool
+WriteBehindPib::hasKey(const Name& keyName) const
+{
+  return m_memory.hasKey(keyName);
+}
+
+void
+WriteBehindPib::addKey(const Name& identity, const Name& keyName,
+		       const uint8_t* key, size_t keyLen)
+{
+  m_memory.addKey(identity, keyName, key, keyLen);
+  auto bits = make_shared<Buffer>(key, keyLen);
+  writeBehind([identity, keyName, bits] (PibImpl& pib) {
+      pib.addKey(identity, keyName, bits->data(), bits->size());
+    });
+}
+
+void
+WriteBehindPib::removeKey(const Name& keyName)
+{
+  m_memory.removeKey(keyName);
+  writeBehind([keyName] (PibImpl& pib) { pib.removeKey(keyName); });
+}
+
+Buffer
+WriteBehindPib::getKeyBits(const Name& keyName) const
+{
+  return m_memory.getKeyBits(keyName);
+}
+
+std::set<Name>
+WriteBehindPib::getKeysOfIdentity(const Name& identity) const
+{
+  return m_memory.getKeysOfIdentity(identity);
+}
+
+void
+WriteBehindPib::setDefaultKeyOfIdentity(const Name& identity, const Name& keyName)
+{
+  m_memory.setDefaultKeyOfIdentity(identity, keyName);
+  writeBehind([identity, keyName] (PibImpl& pib) {
+      pib.setDefaultKeyOfIdentity(identity, keyName);
+    });
+}
+
+Name
+WriteBehindPib::getDefaultKeyOfIdentity(const Name& identity) const
+{
+  return m_memory.getDefaultKeyOfIdentity(identity);
+}
+
+bool
+WriteBehindPib::hasCertificate(const Name& certName) const
+{
+  return m_memory.hasCertificate(certName);
+}
+
+void
+WriteBehindPib::addCertificate(const security::v2::Certificate& certificate)
+{
+  m_memory.addCertificate(certificate);
+  writeBehind([certificate] (PibImpl& pib) { pib.addCertificate(certificate); });
+}
+
+void
+WriteBehindPib::removeCertificate(const Name& certName)
+{
+  m_memory.removeCertificate(certName);
+  writeBehind([certName] (PibImpl& pib) { pib.removeCertificate(certName); });
+}
+
+security::v2::Certificate
+WriteBehindPib::getCertificate(const Name& certName) const
+{
+  return m_memory.getCertificate(certName);
+}
+
+std::set<Name>
+WriteBehindPib::getCertificatesOfKey(const Name& keyName) const
+{
+  return m_memory.getCertificatesOfKey(keyName);
+}
+
+void
+WriteBehindPib::setDefaultCertificateOfKey(const Name& keyName, const Name& certName)
+{
+  m_memory.setDefaultCertificateOfKey(keyName, certName);
+  writeBehind([keyName, certName] (PibImpl& pib) {
+      pib.setDefaultCertificateOfKey(keyName, certName);
+    });
+}
+
+security::v2::Certificate
+WriteBehindPib::getDefaultCertificateOfKey(const Name& keyName) const
+{
+  return m_memory.getDefaultCertificateOfKey(keyName);
+}
+
+} // namespace iot
+} // namespace ndn
@@ -0,0 +1,143 @@
+#ifndef NDN_IOT_WRITE_BEHIND_PIB_HPP
+#define NDN_IOT_WRITE_BEHIND_PIB_HPP
+
+#include <ndn-cxx/security/pib/pib-impl.hpp>
+#include <ndn-cxx/security/pib/pib-memory.hpp>
+#include <ndn-cxx/security/pib/pib-sqlite3.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ndn {
+namespace iot {
+
+/** @brief A PIB served from memory and written behind to the SQLite PIB
+ *
+ *  The SQLite PIB at the location is loaded into memory when the PIB is opened; from
+ *  then on, reads are answered from memory, and updates are applied to memory and queued.
+ *  A thread of the PIB writes the queued updates through every FLUSH_INTERVAL, as one
+ *  batch, and the last ones when the PIB is closed, so updates are lost only if the
+ *  process crashes in between.  Select it with the "pib-write-behind:" locator.
+ */
+class WriteBehindPib : public security::pib::PibImpl
+{
+public:
+  static const time::milliseconds FLUSH_INTERVAL;
+
+  explicit
+  WriteBehindPib(const std::string& location = "");
+
+  ~WriteBehindPib();
+
+  static const std::string&
+  getScheme();
+
+public: // TpmLocator management
+  void
+  setTpmLocator(const std::string& tpmLocator) final;
+
+  std::string
+  getTpmLocator() const final;
+
+public: // Identity management
+  bool
+  hasIdentity(const Name& identity) const final;
+
+  void
+  addIdentity(const Name& identity) final;
+
+  void
+  removeIdentity(const Name& identity) final;
+
+  void
+  clearIdentities() final;
+
+  std::set<Name>
+  getIdentities() const final;
+
+  void
+  setDefaultIdentity(const Name& identityName) final;
+
+  Name
+  getDefaultIdentity() const final;
+
+public: // Key management
+  bool
+  hasKey(const Name& keyName) const final;
+
+  void
+  addKey(const Name& identity, const Name& keyName, const uint8_t* key, size_t keyLen) final;
+
+  void
+  removeKey(const Name& keyName) final;
+
+  Buffer
+  getKeyBits(const Name& keyName) const final;
+
+  std::set<Name>
+  getKeysOfIdentity(const Name& identity) const final;
+
+  void
+  setDefaultKeyOfIdentity(const Name& identity, const Name& keyName) final;
+
+  Name
+  getDefaultKeyOfIdentity(const Name& identity) const final;
+
+public: // Certificate management
+  bool
+  hasCertificate(const Name& certName) const final;
+
+  void
+  addCertificate(const security::v2::Certificate& certificate) final;
+
+  void
+  removeCertificate(const Name& certName) final;
+
+  security::v2::Certificate
+  getCertificate(const Name& certName) const final;
+
+  std::set<Name>
+  getCertificatesOfKey(const Name& keyName) const final;
+
+  void
+  setDefaultCertificateOfKey(const Name& keyName, const Name& certName) final;
+
+  security::v2::Certificate
+  getDefaultCertificateOfKey(const Name& keyName) const final;
+
+private:
+  typedef std::function<void(security::pib::PibImpl& pib)> Write;
+
+  void
+  load();
+
+  void
+  writeBehind(const Write& write);
+
+  void
+  flushPeriodically();
+
+  /** @brief apply the queued writes to the SQLite PIB
+   */
+  void
+  flush();
+
+private:
+  security::pib::PibMemory m_memory;
+  security::pib::PibSqlite3 m_sqlite; // only touched by flush() once loaded
+
+  std::mutex m_mutex;
+  std::condition_variable m_stop;
+  std::vector<Write> m_writes;
+  bool m_isStopped;
+  std::thread m_thread;
+};
+
+} // namespace iot
+} // namespace ndn
+
+#endif // NDN_IOT_WRITE_BEHIND_PIB_HPP